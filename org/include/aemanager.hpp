@@ -61,10 +61,9 @@ public:
     symbol emission_symbol;
   };
 
-  struct addfeature_args {
+  struct addfeatures_args {
     name org;
-    symbol badge_symbol;
-    name notify_account;
+    vector<pair<symbol, name>> features;
     string memo;
   };
 private:
@@ -3,11 +3,15 @@
 #include <eosio/system.hpp>
 #include "orginterface.hpp"
 #include "authorityinterface.hpp"
+#include "subscriptioninterface.hpp"
+#include <json.hpp>
 
 using namespace std;
 using namespace eosio;
 using namespace org_contract;
 using namespace authority_contract;
+using namespace subscription_contract;
+using json = nlohmann::json;
 
 #define SIMPLEBADGE_CONTRACT "simplebaddev"
 #define BADGEDATA_CONTRACT "badgedatadev"
@@ -17,7 +21,8 @@ using namespace authority_contract;
 #define BOUNTIES_CONTRACT "bountiesdevd"
 #define ANDEMITTER_CONTRACT "andemittedev"
 
-#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyachiev"
+#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyissue"
+#define BATCH_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifybatch"
 
 CONTRACT andemitter : public contract {
 public:
@@ -28,13 +33,22 @@ public:
         asset emit_asset;
     };
 
-    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyachiev(
+    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyissue(
+        uint8_t version,
         name org,
         asset amount, 
         name from, 
         name to, 
-        string memo, 
-        vector<name> notify_accounts
+        uint64_t issuance_seq, 
+        std::optional<uint64_t> balance
+    );
+
+    [[eosio::on_notify(BATCH_ISSUANCE_NOTIFICATION)]] void notifybatch(
+        name org,
+        symbol badge_symbol,
+        name from,
+        vector<pair<name, int64_t>> recipients,
+        string memo
     );
 
     ACTION newemission(
@@ -51,8 +65,74 @@ public:
     ACTION deactivate(name org, symbol emission_symbol);
     ACTION onckeyvalue(name org, symbol emission_symbol, string key, string value);
     ACTION offckeyvalue(name org, symbol emission_symbol, string key, string value);
+    ACTION onckvpatch(name org, symbol emission_symbol, vector<kvop> ops);
+    ACTION offckvpatch(name org, symbol emission_symbol, vector<kvop> ops);
+
+    struct lookup_field {
+        string section; // "user" or "system"
+        string key;
+        string value;
+    };
+
+    struct emission_view {
+        symbol emission_symbol;
+        vector<lookup_field> offchain_lookup;
+        vector<lookup_field> onchain_lookup;
+        vector<asset> emitter_criteria;
+        vector<contract_asset> emit_assets;
+        name status;
+        bool cyclic;
+    };
+
+    [[eosio::action, eosio::read_only]] emission_view getemission(name org, symbol emission_symbol);
 
 private:
+
+    void patch_offchain_lookup(name org, symbol emission_symbol, const vector<kvop>& ops, string failure_identifier) {
+        emissions_table emissions(get_self(), org.value);
+        auto itr = emissions.find(emission_symbol.code().raw());
+        check(itr != emissions.end(), failure_identifier + "Emission does not exist");
+
+        string patched = patch_lookup_json(itr->offchain_lookup_data, ops, failure_identifier);
+        emissions.modify(itr, get_self(), [&](auto& row) {
+            row.offchain_lookup_data = patched;
+        });
+    }
+
+    void patch_onchain_lookup(name org, symbol emission_symbol, const vector<kvop>& ops, string failure_identifier) {
+        emissions_table emissions(get_self(), org.value);
+        auto itr = emissions.find(emission_symbol.code().raw());
+        check(itr != emissions.end(), failure_identifier + "Emission does not exist");
+
+        string patched = patch_lookup_json(itr->onchain_lookup_data, ops, failure_identifier);
+        emissions.modify(itr, get_self(), [&](auto& row) {
+            row.onchain_lookup_data = patched;
+        });
+    }
+
+    vector<lookup_field> flatten_lookup(const string& json_str) {
+        vector<lookup_field> fields;
+        if (json_str.empty() || !nlohmann::json::accept(json_str)) {
+            return fields;
+        }
+        nlohmann::json j = nlohmann::json::parse(json_str);
+        if (!j.is_object()) {
+            return fields;
+        }
+        for (auto& [section_name, section_obj] : j.items()) {
+            if (!section_obj.is_object()) {
+                continue;
+            }
+            for (auto& [key, value] : section_obj.items()) {
+                fields.push_back(lookup_field {
+                    .section = section_name,
+                    .key = key,
+                    .value = value.is_string() ? value.get<string>() : value.dump()
+                });
+            }
+        }
+        return fields;
+    }
     
     TABLE emissions {
         symbol emission_symbol;
@@ -167,10 +247,39 @@ private:
             }
         }
     }
-    struct billing_args {
-      name org;
-      uint8_t actions_used;
-    };
+    // Advances every active emission listening on the badge for one recipient.
+    uint64_t process_achievement(name org, const asset& amount, name to, const vector<symbol>& active_emissions, string failure_identifier) {
+        emissions_table emissions(get_self(), org.value);
+        accounts_table accounts(get_self(), to.value);
+
+        uint64_t actions_used = 0;
+        for (const auto& emission_symbol : active_emissions) {
+            auto emission_itr = emissions.find(emission_symbol.code().raw());
+            check(emission_itr != emissions.end(), "Emission does not exist");
+
+            auto account_itr = accounts.find(emission_symbol.code().raw());
+            uint8_t emission_status = emission_itr->cyclic ? CYCLIC_IN_PROGRESS : NON_CYCLIC_IN_PROGRESS;
+
+            if (account_itr != accounts.end() && account_itr->emission_status == NON_CYCLIC_EMITTED) continue;
+
+            if (account_itr == accounts.end()) {
+                account_itr = accounts.emplace(get_self(), [&](auto& acc) {
+                    acc.emission_symbol = emission_symbol;
+                    acc.emission_status = emission_status;
+                });
+            }
+            auto expanded_emitter_status_map = account_itr->expanded_emitter_status;
+            update_expanded_emitter_status(to, expanded_emitter_status_map, amount, *emission_itr, emission_status, failure_identifier);
+
+            accounts.modify(account_itr, get_self(), [&](auto& acc) {
+                acc.expanded_emitter_status = expanded_emitter_status_map;
+                acc.emission_status = emission_status;
+            });
+            actions_used++;
+        }
+        return actions_used;
+    }
+
     struct issue_args {
       name org;
       asset badge_asset;
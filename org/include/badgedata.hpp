@@ -1,14 +1,28 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 #include <eosio/system.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/singleton.hpp>
 
 #include "authorityinterface.hpp"
+#include "orginterface.hpp"
+#include "cumulativeinterface.hpp"
+#include "subscriptioninterface.hpp"
+#include <json.hpp>
+using json = nlohmann::json;
 
 using namespace std;
 using namespace eosio;
 using namespace authority_contract;
+using namespace subscription_contract;
 
 #define BADGEDATA_CONTRACT "badgedatadev"
+#define SUBSCRIPTION_CONTRACT "subscribedev"
+#define CUMULATIVE_CONTRACT "cumulativdev"
+#define STATISTICS_CONTRACT "statisticdev"
+#define BOUNDED_AGG_CONTRACT "boundedagdev"
+#define BOUNDED_STATS_CONTRACT "boundedstdev"
+#define ANDEMITTER_CONTRACT "andemittedev"
 
 CONTRACT badgedata : public contract {
 public:
@@ -28,13 +42,14 @@ public:
     name notify_account, 
     string memo);
 
+  // Carries only a hash of the badge metadata; consumers that need the lookup data
+  // fetch it with the read-only lookupjson or getbadge actions.
   ACTION addnotify(
     name org,
     symbol badge_symbol, 
     name notify_account, 
     string memo, 
-    string offchain_lookup_data, 
-    string onchain_lookup_data, 
+    checksum256 metadata_hash, 
     uint64_t rarity_counts);
 
   ACTION delfeature(
@@ -48,10 +63,31 @@ public:
     symbol badge_symbol, 
     name notify_account, 
     string memo, 
-    string offchain_lookup_data, 
-    string onchain_lookup_data, 
+    checksum256 metadata_hash, 
     uint64_t rarity_counts);
 
+  ACTION addfeatures(
+    name org,
+    vector<pair<symbol, name>> features,
+    string memo);
+
+  ACTION delfeatures(
+    name org,
+    vector<pair<symbol, name>> features,
+    string memo);
+
+  struct featurechange {
+    symbol badge_symbol;
+    name notify_account;
+    checksum256 metadata_hash;
+    uint64_t rarity_counts;
+  };
+
+  // Combined addnotify/delnotify for a whole addfeatures/delfeatures call.
+  ACTION addnotifs(name org, vector<featurechange> changes, string memo);
+
+  ACTION delnotifs(name org, vector<featurechange> changes, string memo);
+
   ACTION achievement(
     name org,
     asset badge_asset, 
@@ -59,6 +95,8 @@ public:
     name to, 
     string memo);
 
+  // Superseded by notifyissue and no longer sent; kept so the action stays in the ABI for
+  // existing listeners. Notifies only the accounts it is given.
   ACTION notifyachiev(
     name org,
     asset badge_asset, 
@@ -67,6 +105,31 @@ public:
     string memo, 
     vector<name> notify_accounts);
 
+  // Slim issuance notification: no memo or subscriber list, plus an org-wide issuance
+  // sequence number and the recipient's post-issuance balance when badgedata knows it.
+  ACTION notifyissue(
+    uint8_t version,
+    name org,
+    asset badge_asset,
+    name from,
+    name to,
+    uint64_t issuance_seq,
+    std::optional<uint64_t> balance);
+
+  ACTION achievements(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo);
+
+  ACTION notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo);
+
   ACTION offckeyvalue(name org, 
     symbol badge_symbol, 
     string key, 
@@ -77,6 +140,66 @@ public:
     string key, 
     string value);
 
+  ACTION offckvpatch(name org, symbol badge_symbol, vector<org_contract::kvop> ops);
+
+  ACTION onckvpatch(name org, symbol badge_symbol, vector<org_contract::kvop> ops);
+
+  ACTION migratemeta(name org, uint32_t limit);
+
+  ACTION migratesubs(name org, uint32_t limit);
+
+  // Opts the org in to the issuance event log with room for `capacity` events, or out with 0.
+  ACTION seteventlog(name org, uint32_t capacity);
+
+  // Frees up to `limit` slots a smaller capacity left behind; rerun until none is left.
+  ACTION trimevents(name org, uint32_t limit);
+
+  struct lookup_json {
+    string offchain_lookup_data;
+    string onchain_lookup_data;
+  };
+
+  [[eosio::action, eosio::read_only]] lookup_json lookupjson(name org, symbol badge_symbol);
+
+  struct lookup_field {
+    string section; // "user", "system" or a section carried over from legacy JSON
+    string key;
+    string value;
+  };
+
+  struct badge_view {
+    symbol badge_symbol;
+    uint64_t rarity_counts;
+    vector<name> notify_accounts;
+    vector<lookup_field> offchain_lookup;
+    vector<lookup_field> onchain_lookup;
+  };
+
+  struct badge_page {
+    vector<badge_view> badges;
+    symbol_code next; // pass as lower to fetch the next page, empty when done
+  };
+
+  [[eosio::action, eosio::read_only]] badge_view getbadge(name org, symbol badge_symbol);
+
+  struct issuance_event {
+    uint64_t seq;
+    symbol badge_symbol;
+    name to;
+    int64_t amount;
+    time_point_sec block_time;
+  };
+
+  struct event_page {
+    vector<issuance_event> events;
+    uint64_t oldest_seq; // events before this were overwritten; a cursor below it has a gap
+    uint64_t next_seq;   // pass as from_seq to resume
+  };
+
+  [[eosio::action, eosio::read_only]] event_page events(name org, uint64_t from_seq, uint32_t limit);
+
+  [[eosio::action, eosio::read_only]] badge_page getbadges(name org, symbol_code lower, uint32_t limit);
+
 private:
 
     
@@ -100,13 +223,30 @@ private:
     vector<name> notify_accounts;
   };
 
+  struct notifyissue_args {
+    uint8_t version;
+    name org;
+    asset badge_asset;
+    name from;
+    name to;
+    uint64_t issuance_seq;
+    std::optional<uint64_t> balance;
+  };
+
+  struct notifybatch_args {
+    name org;
+    symbol badge_symbol;
+    name from;
+    vector<pair<name, int64_t>> recipients;
+    string memo;
+  };
+
   struct downstream_notify_args {
     name org;
     symbol badge_symbol;
     name notify_account;
     string memo;
-    string offchain_lookup_data;
-    string onchain_lookup_data;
+    checksum256 metadata_hash;
     uint64_t rarity_counts;
   };
 
@@ -115,6 +255,12 @@ private:
     name account;
   };
 
+  struct notifyfeatures_args {
+    name org;
+    vector<featurechange> changes;
+    string memo;
+  };
+
   struct local_addfeature_args {
     name org;
     name badge;
@@ -132,9 +278,568 @@ private:
   };
   typedef multi_index<name("badge"), badge> badge_table;
 
-  bool badge_exists(symbol badge_symbol) {
-      badge_table badges(name(BADGEDATA_CONTRACT), name(BADGEDATA_CONTRACT).value);
-      return badges.find(badge_symbol.code().raw()) != badges.end();
+  // scoped by org. Kept apart from the badge row so issuance only rewrites this small row.
+  TABLE rarity {
+    symbol badge_symbol;
+    uint64_t rarity_counts;
+    auto primary_key() const { return badge_symbol.code().raw(); }
+  };
+  typedef multi_index<name("rarity"), rarity> rarity_table;
+
+  // Rows created before the split are seeded from the frozen badge.rarity_counts.
+  void add_rarity(name org, const badge& badge_row, int64_t amount) {
+    rarity_table rarity_t(get_self(), org.value);
+    auto itr = rarity_t.find(badge_row.badge_symbol.code().raw());
+    if (itr == rarity_t.end()) {
+      rarity_t.emplace(get_self(), [&](auto& row) {
+        row.badge_symbol = badge_row.badge_symbol;
+        row.rarity_counts = badge_row.rarity_counts + amount;
+      });
+    } else {
+      rarity_t.modify(itr, get_self(), [&](auto& row) {
+        row.rarity_counts += amount;
+      });
+    }
+  }
+
+  uint64_t rarity_counts(name org, const badge& badge_row) {
+    rarity_table rarity_t(get_self(), org.value);
+    auto itr = rarity_t.find(badge_row.badge_symbol.code().raw());
+    return itr == rarity_t.end() ? badge_row.rarity_counts : itr->rarity_counts;
+  }
+
+  // scoped by badgedata contract. A consumer's id is its index in accounts.
+  TABLE registry {
+    vector<name> accounts;
+  };
+  typedef eosio::singleton<"registry"_n, registry> registry_singleton;
+
+  // scoped by org. Consumers read each other's tables while handling a notification
+  // (statistics reads cumulative, boundedstats reads boundedagg), so they are notified in
+  // the order the badge subscribed them, as with the legacy notify_accounts list.
+  TABLE subscribers {
+    symbol badge_symbol;
+    uint64_t notify_mask;          // bit i set: registry.accounts[i] is notified
+    vector<uint8_t> notify_order;  // the same ids, in subscription order
+    auto primary_key() const { return badge_symbol.code().raw(); }
+  };
+  typedef multi_index<name("subscribers"), subscribers> subscribers_table;
+
+  registry load_registry() {
+    registry_singleton registry_s(get_self(), get_self().value);
+    if (registry_s.exists()) {
+      return registry_s.get();
+    }
+    return registry {
+      .accounts = {
+        name(SUBSCRIPTION_CONTRACT),
+        name(CUMULATIVE_CONTRACT),
+        name(STATISTICS_CONTRACT),
+        name(BOUNDED_AGG_CONTRACT),
+        name(BOUNDED_STATS_CONTRACT),
+        name(ANDEMITTER_CONTRACT)
+      }
+    };
+  }
+
+  // Lookup only; an account that was never registered cannot be subscribed to anything.
+  std::optional<uint8_t> find_consumer(name account) {
+    registry reg = load_registry();
+    auto itr = std::find(reg.accounts.begin(), reg.accounts.end(), account);
+    if (itr == reg.accounts.end()) {
+      return std::nullopt;
+    }
+    return static_cast<uint8_t>(itr - reg.accounts.begin());
+  }
+
+  uint8_t register_consumer(name account) {
+    registry reg = load_registry();
+    auto itr = std::find(reg.accounts.begin(), reg.accounts.end(), account);
+    uint8_t consumer_id = itr - reg.accounts.begin();
+    registry_singleton registry_s(get_self(), get_self().value);
+    if (itr == reg.accounts.end()) {
+      check(reg.accounts.size() < 64, "subscriber registry is full");
+      reg.accounts.push_back(account);
+      registry_s.set(reg, get_self());
+    } else if (!registry_s.exists()) {
+      registry_s.set(reg, get_self());
+    }
+    return consumer_id;
+  }
+
+  // Returns false when the consumer already was in the requested state.
+  bool set_subscribed(subscribers& row, uint8_t consumer_id, bool subscribe) {
+    uint64_t bit = 1ULL << consumer_id;
+    if (((row.notify_mask & bit) != 0) == subscribe) {
+      return false;
+    }
+    if (subscribe) {
+      row.notify_mask |= bit;
+      row.notify_order.push_back(consumer_id);
+    } else {
+      row.notify_mask &= ~bit;
+      row.notify_order.erase(std::remove(row.notify_order.begin(), row.notify_order.end(), consumer_id), row.notify_order.end());
+    }
+    return true;
+  }
+
+  vector<name> resolve_order(const vector<uint8_t>& notify_order) {
+    registry reg = load_registry();
+    vector<name> accounts;
+    accounts.reserve(notify_order.size());
+    for (const auto& consumer_id : notify_order) {
+      accounts.push_back(reg.accounts[consumer_id]);
+    }
+    return accounts;
+  }
+
+  // Converts the notify_accounts of a legacy badge row into a subscribers row and clears it.
+  void migrate_subscribers(name org, badge_table& badges, badge_table::const_iterator badge_itr) {
+    subscribers row { .badge_symbol = badge_itr->badge_symbol, .notify_mask = 0 };
+    for (const auto& account : badge_itr->notify_accounts) {
+      set_subscribed(row, register_consumer(account), true);
+    }
+    subscribers_table subscribers_t(get_self(), org.value);
+    subscribers_t.emplace(get_self(), [&](auto& entry) {
+      entry = row;
+    });
+    if (!badge_itr->notify_accounts.empty()) {
+      badges.modify(badge_itr, get_self(), [&](auto& entry) {
+        entry.notify_accounts.clear();
+      });
+    }
+  }
+
+  subscribers load_subscribers(name org, symbol badge_symbol) {
+    subscribers_table subscribers_t(get_self(), org.value);
+    auto itr = subscribers_t.find(badge_symbol.code().raw());
+    if (itr != subscribers_t.end()) {
+      return *itr;
+    }
+    badge_table badges(get_self(), org.value);
+    auto badge_itr = badges.find(badge_symbol.code().raw());
+    check(badge_itr != badges.end(), "Badge does not exist");
+    migrate_subscribers(org, badges, badge_itr);
+    return subscribers_t.get(badge_symbol.code().raw());
+  }
+
+  void store_subscribers(name org, const subscribers& row) {
+    subscribers_table subscribers_t(get_self(), org.value);
+    auto itr = subscribers_t.find(row.badge_symbol.code().raw());
+    check(itr != subscribers_t.end(), "Badge subscribers do not exist");
+    subscribers_t.modify(itr, get_self(), [&](auto& entry) {
+      entry = row;
+    });
+  }
+
+  // Applies one subscribers rewrite per badge for a batch of (badge, consumer) pairs and
+  // returns the pairs that actually changed. Within a badge the pairs keep the given order,
+  // which becomes their notification order.
+  vector<featurechange> apply_features(name org, vector<pair<symbol, name>> features, bool subscribe) {
+    std::stable_sort(features.begin(), features.end(), [](const auto& a, const auto& b) {
+      return a.first.code().raw() < b.first.code().raw();
+    });
+    vector<featurechange> changes;
+    for (auto group = features.begin(); group != features.end();) {
+      symbol badge_symbol = group->first;
+      auto group_end = std::find_if(group, features.end(), [&](const auto& f) { return f.first.code() != badge_symbol.code(); });
+
+      ensure_migrated(org, badge_symbol);
+      subscribers row = load_subscribers(org, badge_symbol);
+      vector<name> changed_accounts;
+      for (auto f = group; f != group_end; f++) {
+        std::optional<uint8_t> consumer_id = subscribe ? register_consumer(f->second) : find_consumer(f->second);
+        if (consumer_id.has_value() && set_subscribed(row, *consumer_id, subscribe)) {
+          changed_accounts.push_back(f->second);
+        }
+      }
+      if (!changed_accounts.empty()) {
+        store_subscribers(org, row);
+
+        metadata_table metadata_t(get_self(), org.value);
+        checksum256 hash = metadata_hash(metadata_t.get(badge_symbol.code().raw()));
+        badge_table badges(get_self(), org.value);
+        uint64_t counts = rarity_counts(org, badges.get(badge_symbol.code().raw()));
+        for (const auto& account : changed_accounts) {
+          changes.push_back(featurechange {
+            .badge_symbol = badge_symbol,
+            .notify_account = account,
+            .metadata_hash = hash,
+            .rarity_counts = counts
+          });
+        }
+      }
+      group = group_end;
+    }
+    return changes;
+  }
+
+  // Fan-out list resolved at notify time; legacy rows fall back to notify_accounts.
+  vector<name> subscribed_accounts(name org, symbol badge_symbol) {
+    subscribers_table subscribers_t(get_self(), org.value);
+    auto itr = subscribers_t.find(badge_symbol.code().raw());
+    if (itr != subscribers_t.end()) {
+      return resolve_order(itr->notify_order);
+    }
+    badge_table badges(get_self(), org.value);
+    auto badge_itr = badges.find(badge_symbol.code().raw());
+    return badge_itr == badges.end() ? vector<name>() : badge_itr->notify_accounts;
+  }
+
+  static constexpr uint8_t NOTIFY_ISSUE_VERSION = 1;
+
+  // scoped by org
+  TABLE issuanceseq {
+    uint64_t last_issuance_seq;
+  };
+  typedef eosio::singleton<"issuanceseq"_n, issuanceseq> issuanceseq_singleton;
+
+  // Reserves count consecutive sequence numbers and returns the first one.
+  uint64_t next_issuance_seq(name org, uint64_t count = 1) {
+    issuanceseq_singleton issuanceseq_s(get_self(), org.value);
+    issuanceseq seq = issuanceseq_s.get_or_default(issuanceseq { .last_issuance_seq = 0 });
+    uint64_t first_seq = seq.last_issuance_seq + 1;
+    seq.last_issuance_seq += count;
+    issuanceseq_s.set(seq, get_self());
+    return first_seq;
+  }
+
+  uint64_t last_issuance_seq(name org) {
+    issuanceseq_singleton issuanceseq_s(get_self(), org.value);
+    return issuanceseq_s.exists() ? issuanceseq_s.get().last_issuance_seq : 0;
+  }
+
+  static constexpr uint32_t MAX_EVENT_LOG_CAPACITY = 4096;
+
+  // scoped by org. Present only for orgs that opted in to the event log; events from
+  // first_seq on are kept.
+  TABLE eventlogcfg {
+    uint32_t capacity;
+    uint64_t first_seq;
+  };
+  typedef eosio::singleton<"eventlogcfg"_n, eventlogcfg> eventlogcfg_singleton;
+
+  // Slots seteventlog frees itself; the rest are left to trimevents.
+  static constexpr uint32_t EVENT_LOG_TRIM_BATCH = 256;
+
+  uint32_t event_log_capacity(name org) {
+    eventlogcfg_singleton eventlogcfg_s(get_self(), org.value);
+    return eventlogcfg_s.exists() ? eventlogcfg_s.get().capacity : 0;
+  }
+
+  // scoped by org, a ring buffer: the event with sequence seq lives in slot seq % capacity.
+  // Slots are created as the ring first fills, and each logged event is billed to the org as
+  // one action.
+  TABLE eventlog {
+    uint64_t slot;
+    uint64_t seq;
+    symbol badge_symbol;
+    name to;
+    int64_t amount;
+    time_point_sec block_time;
+    auto primary_key() const { return slot; }
+  };
+  typedef multi_index<name("eventlog"), eventlog> eventlog_table;
+
+  // Erases up to limit slots at or above capacity and returns how many were erased.
+  uint32_t trim_event_log(name org, uint32_t capacity, uint32_t limit) {
+    eventlog_table eventlog_t(get_self(), org.value);
+    uint32_t erased = 0;
+    for (auto itr = eventlog_t.lower_bound(capacity); itr != eventlog_t.end() && erased < limit; erased++) {
+      itr = eventlog_t.erase(itr);
+    }
+    return erased;
+  }
+
+  bool event_log_trimmed(name org, uint32_t capacity) {
+    eventlog_table eventlog_t(get_self(), org.value);
+    return eventlog_t.lower_bound(capacity) == eventlog_t.end();
+  }
+
+  void log_event(name org, uint32_t capacity, uint64_t seq, symbol badge_symbol, name to, int64_t amount) {
+    eventlog_table eventlog_t(get_self(), org.value);
+    uint64_t slot = seq % capacity;
+    auto fill = [&](auto& row) {
+      row.slot = slot;
+      row.seq = seq;
+      row.badge_symbol = badge_symbol;
+      row.to = to;
+      row.amount = amount;
+      row.block_time = time_point_sec(current_time_point());
+    };
+    auto itr = eventlog_t.find(slot);
+    if (itr == eventlog_t.end()) {
+      eventlog_t.emplace(get_self(), fill);
+    } else {
+      eventlog_t.modify(itr, get_self(), fill);
+    }
+  }
+
+  // Known when cumulative tracks the badge, and only looked up when statistics, the one
+  // consumer that uses it, is subscribed too. Cumulative credits the recipient while handling
+  // this same notification, so the balance it holds now is still the pre-issuance one.
+  std::optional<uint64_t> balance_after(name org, name to, const asset& badge_asset) {
+    vector<name> accounts = subscribed_accounts(org, badge_asset.symbol);
+    if (std::find(accounts.begin(), accounts.end(), name(CUMULATIVE_CONTRACT)) == accounts.end() ||
+        std::find(accounts.begin(), accounts.end(), name(STATISTICS_CONTRACT)) == accounts.end()) {
+      return std::nullopt;
+    }
+    cumulative_contract::accounts accounts_t(name(CUMULATIVE_CONTRACT), to.value);
+    auto itr = accounts_t.find(badge_asset.symbol.code().raw());
+    uint64_t balance = itr == accounts_t.end() ? 0 : itr->balance.amount;
+    return balance + badge_asset.amount;
+  }
+
+  enum lookup_section : uint8_t {
+    USER_SECTION = 1,
+    SYSTEM_SECTION = 2,
+    EXTRA_SECTION = 3 // any other top-level member of legacy JSON, stored whole under its name
+  };
+
+  struct lookupentry {
+    uint8_t section;   // USER_SECTION, SYSTEM_SECTION or EXTRA_SECTION
+    uint32_t key_id;   // interned key, see lookupkeys table
+    bool json_value;   // value is JSON text (number, bool, object...) rather than a plain string
+    string value;
+  };
+
+  // scoped by org, entries kept sorted by (section, key_id)
+  TABLE metadata {
+    symbol badge_symbol;
+    vector<lookupentry> offchain_lookup;
+    vector<lookupentry> onchain_lookup;
+    auto primary_key() const { return badge_symbol.code().raw(); }
+  };
+  typedef multi_index<name("metadata"), metadata> metadata_table;
+
+  // scoped by badgedata contract
+  TABLE lookupkey {
+    uint64_t key_id;
+    string key;
+    uint64_t primary_key() const { return key_id; }
+    checksum256 by_key() const { return sha256(key.data(), key.size()); }
+  };
+  typedef multi_index<name("lookupkeys"), lookupkey,
+    indexed_by<name("bykey"), const_mem_fun<lookupkey, checksum256, &lookupkey::by_key>>
+  > lookupkey_table;
+
+  uint32_t intern_key(const string& key) {
+    lookupkey_table lookupkeys(get_self(), get_self().value);
+    auto by_key_index = lookupkeys.get_index<name("bykey")>();
+    auto itr = by_key_index.find(sha256(key.data(), key.size()));
+    if (itr != by_key_index.end() && itr->key == key) {
+      return static_cast<uint32_t>(itr->key_id);
+    }
+    uint64_t key_id = lookupkeys.available_primary_key();
+    check(key_id <= UINT32_MAX, "lookup key space exhausted");
+    lookupkeys.emplace(get_self(), [&](auto& row) {
+      row.key_id = key_id;
+      row.key = key;
+    });
+    return static_cast<uint32_t>(key_id);
+  }
+
+  string key_for(uint32_t key_id) {
+    lookupkey_table lookupkeys(get_self(), get_self().value);
+    auto itr = lookupkeys.find(key_id);
+    check(itr != lookupkeys.end(), "lookup key not interned");
+    return itr->key;
+  }
+
+  void put_lookup(vector<lookupentry>& entries, uint8_t section, const string& key, const string& value, bool json_value = false) {
+    uint32_t key_id = intern_key(key);
+    auto itr = std::lower_bound(entries.begin(), entries.end(), std::make_pair(section, key_id),
+      [](const lookupentry& e, const std::pair<uint8_t, uint32_t>& k) {
+        return std::make_pair(e.section, e.key_id) < k;
+      });
+    if (itr != entries.end() && itr->section == section && itr->key_id == key_id) {
+      itr->json_value = json_value;
+      itr->value = value;
+    } else {
+      entries.insert(itr, lookupentry { .section = section, .key_id = key_id, .json_value = json_value, .value = value });
+    }
+  }
+
+  void erase_lookup(vector<lookupentry>& entries, uint8_t section, const string& key) {
+    lookupkey_table lookupkeys(get_self(), get_self().value);
+    auto by_key_index = lookupkeys.get_index<name("bykey")>();
+    auto key_itr = by_key_index.find(sha256(key.data(), key.size()));
+    if (key_itr == by_key_index.end() || key_itr->key != key) {
+      return;
+    }
+    uint32_t key_id = static_cast<uint32_t>(key_itr->key_id);
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const lookupentry& e) {
+      return e.section == section && e.key_id == key_id;
+    }), entries.end());
+  }
+
+  // Binary counterpart of org_contract::patch_lookup_json: the row is read and written once.
+  void patch_lookup(vector<lookupentry>& entries, const vector<org_contract::kvop>& ops, string failure_identifier) {
+    for (const auto& op : ops) {
+      check(op.key != "system", failure_identifier + "Cannot modify system tag");
+      if (op.value.has_value()) {
+        put_lookup(entries, USER_SECTION, op.key, *op.value);
+      } else {
+        erase_lookup(entries, USER_SECTION, op.key);
+      }
+    }
+  }
+
+  // Changes whenever any lookup entry changes, so consumers can tell if their copy is stale.
+  checksum256 metadata_hash(const metadata& row) {
+    auto packed = eosio::pack(row);
+    return sha256(packed.data(), packed.size());
+  }
+
+  static nlohmann::json lookup_value(const lookupentry& entry) {
+    return entry.json_value ? nlohmann::json::parse(entry.value) : nlohmann::json(entry.value);
+  }
+
+  // Renders the binary lookup entries in the legacy {"user":{..},"system":{..}} shape.
+  string render_lookup(const vector<lookupentry>& entries) {
+    nlohmann::json j = nlohmann::json::object();
+    for (const auto& entry : entries) {
+      if (entry.section == EXTRA_SECTION) {
+        j[key_for(entry.key_id)] = lookup_value(entry);
+        continue;
+      }
+      string section = entry.section == SYSTEM_SECTION ? "system" : "user";
+      j[section][key_for(entry.key_id)] = lookup_value(entry);
+    }
+    return j.dump();
+  }
+
+  vector<lookupentry> parse_lookup(const string& json_str) {
+    vector<lookupentry> entries;
+    if (json_str.empty() || !nlohmann::json::accept(json_str)) {
+      return entries;
+    }
+    nlohmann::json j = nlohmann::json::parse(json_str);
+    if (!j.is_object()) {
+      return entries;
+    }
+    for (auto& [section_name, section_obj] : j.items()) {
+      if (!section_obj.is_object() || (section_name != "user" && section_name != "system")) {
+        put_lookup(entries, EXTRA_SECTION, section_name, section_obj.dump(), true);
+        continue;
+      }
+      uint8_t section = section_name == "system" ? SYSTEM_SECTION : USER_SECTION;
+      for (auto& [key, value] : section_obj.items()) {
+        put_lookup(entries, section, key, value.is_string() ? value.get<string>() : value.dump(), !value.is_string());
+      }
+    }
+    return entries;
+  }
+
+  static constexpr uint32_t MAX_PAGE_SIZE = 50;
+
+  vector<lookup_field> flatten_lookup(const vector<lookupentry>& entries) {
+    vector<lookup_field> fields;
+    for (const auto& entry : entries) {
+      if (entry.section == EXTRA_SECTION) {
+        string section = key_for(entry.key_id);
+        nlohmann::json section_obj = lookup_value(entry);
+        if (!section_obj.is_object()) {
+          fields.push_back(lookup_field { .section = section, .key = "", .value = entry.value });
+          continue;
+        }
+        for (auto& [key, value] : section_obj.items()) {
+          fields.push_back(lookup_field {
+            .section = section,
+            .key = key,
+            .value = value.is_string() ? value.get<string>() : value.dump()
+          });
+        }
+        continue;
+      }
+      fields.push_back(lookup_field {
+        .section = entry.section == SYSTEM_SECTION ? "system" : "user",
+        .key = key_for(entry.key_id),
+        .value = entry.value
+      });
+    }
+    return fields;
+  }
+
+  // Read-only counterpart of parse_lookup for rows that still carry JSON; interns nothing.
+  vector<lookup_field> flatten_lookup(const string& json_str) {
+    vector<lookup_field> fields;
+    if (json_str.empty() || !nlohmann::json::accept(json_str)) {
+      return fields;
+    }
+    nlohmann::json j = nlohmann::json::parse(json_str);
+    if (!j.is_object()) {
+      return fields;
+    }
+    for (auto& [section_name, section_obj] : j.items()) {
+      if (!section_obj.is_object()) {
+        continue;
+      }
+      for (auto& [key, value] : section_obj.items()) {
+        fields.push_back(lookup_field {
+          .section = section_name,
+          .key = key,
+          .value = value.is_string() ? value.get<string>() : value.dump()
+        });
+      }
+    }
+    return fields;
+  }
+
+  badge_view make_badge_view(name org, const badge& badge_row) {
+    badge_view view {
+      .badge_symbol = badge_row.badge_symbol,
+      .rarity_counts = rarity_counts(org, badge_row),
+      .notify_accounts = subscribed_accounts(org, badge_row.badge_symbol)
+    };
+    if (!badge_row.offchain_lookup_data.empty() || !badge_row.onchain_lookup_data.empty()) {
+      view.offchain_lookup = flatten_lookup(badge_row.offchain_lookup_data);
+      view.onchain_lookup = flatten_lookup(badge_row.onchain_lookup_data);
+      return view;
+    }
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_row.badge_symbol.code().raw());
+    if (itr != metadata_t.end()) {
+      view.offchain_lookup = flatten_lookup(itr->offchain_lookup);
+      view.onchain_lookup = flatten_lookup(itr->onchain_lookup);
+    }
+    return view;
+  }
+
+  // scoped by org. Where migratemeta resumes; badges below next_badge have been visited.
+  TABLE metamigration {
+    uint64_t next_badge; // raw symbol code
+    bool done;
+  };
+  typedef eosio::singleton<"metamigr"_n, metamigration> metamigration_singleton;
+
+  // scoped by org. The same for migratesubs.
+  typedef eosio::singleton<"submigr"_n, metamigration> submigration_singleton;
+
+  // Converts the JSON strings of a legacy badge row into a metadata row and blanks them.
+  void migrate_lookup(name org, badge_table& badges, badge_table::const_iterator badge_itr) {
+    metadata_table metadata_t(get_self(), org.value);
+    if (metadata_t.find(badge_itr->badge_symbol.code().raw()) == metadata_t.end()) {
+      metadata_t.emplace(get_self(), [&](auto& row) {
+        row.badge_symbol    = badge_itr->badge_symbol;
+        row.offchain_lookup = parse_lookup(badge_itr->offchain_lookup_data);
+        row.onchain_lookup  = parse_lookup(badge_itr->onchain_lookup_data);
+      });
+    }
+    badges.modify(badge_itr, get_self(), [&](auto& row) {
+      row.offchain_lookup_data = "";
+      row.onchain_lookup_data  = "";
+    });
+  }
+
+  // Lazily migrates a legacy badge row so callers can work on the metadata table only.
+  void ensure_migrated(name org, symbol badge_symbol) {
+    badge_table badges(get_self(), org.value);
+    auto badge_itr = badges.find(badge_symbol.code().raw());
+    check(badge_itr != badges.end(), "Badge does not exist");
+    if (!badge_itr->offchain_lookup_data.empty() || !badge_itr->onchain_lookup_data.empty()) {
+      migrate_lookup(org, badges, badge_itr);
+    }
   }
 };
 
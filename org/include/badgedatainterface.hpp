@@ -1,7 +1,9 @@
 #pragma once
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <string>
+#include <optional>
 
 using namespace eosio;
 using namespace std;
@@ -30,13 +32,30 @@ namespace badgedata_contract {
     vector<name> notify_accounts;
   };
 
+  struct notifyissue_args {
+    uint8_t version;
+    name org;
+    asset badge_asset;
+    name from;
+    name to;
+    uint64_t issuance_seq;
+    std::optional<uint64_t> balance;
+  };
+
+  struct notifybatch_args {
+    name org;
+    symbol badge_symbol;
+    name from;
+    vector<pair<name, int64_t>> recipients;
+    string memo;
+  };
+
   struct downstream_notify_args {
     name org;
     symbol badge_symbol;
     name notify_account;
     string memo;
-    string offchain_lookup_data;
-    string onchain_lookup_data;
+    checksum256 metadata_hash;
     uint64_t rarity_counts;
   };
 
@@ -62,6 +81,14 @@ namespace badgedata_contract {
   };
   typedef multi_index<name("badge"), badge> badge_table;
 
+  // scoped by org
+  TABLE rarity {
+    symbol badge_symbol;
+    uint64_t rarity_counts;
+    auto primary_key() const { return badge_symbol.code().raw(); }
+  };
+  typedef multi_index<name("rarity"), rarity> rarity_table;
+
   bool badge_exists(symbol badge_symbol, name org) {
       badge_table badges(name(BADGEDATA_CONTRACT), org.value);
       return badges.find(badge_symbol.code().raw()) != badges.end();
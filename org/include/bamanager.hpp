@@ -35,6 +35,9 @@ CONTRACT bamanager : public contract {
     ACTION endseqaa(name authorized, symbol agg_symbol);
     ACTION endseqfa(name authorized, symbol agg_symbol);
     ACTION addbadge(name authorized, symbol agg_symbol, vector<uint64_t> seq_ids, vector<symbol> badge_symbols);
+    ACTION schedseq(name authorized, symbol agg_symbol, vector<symbol> badge_symbols, time_point_sec start, uint32_t length_sec, uint32_t count);
+    ACTION endsched(name authorized, symbol agg_symbol);
+    ACTION settopk(name authorized, symbol agg_symbol, uint16_t k);
 
     ACTION pauseall(name authorized, symbol agg_symbol, uint64_t seq_id);
     ACTION pausebadge(name authorized, symbol agg_symbol, uint64_t badge_agg_seq_id);
@@ -187,6 +190,26 @@ CONTRACT bamanager : public contract {
       vector<symbol> badge_symbols;
     };
 
+    struct schedseq_args {
+      name org;
+      symbol agg_symbol;
+      vector<symbol> badge_symbols;
+      time_point_sec start;
+      uint32_t length_sec;
+      uint32_t count;
+    };
+
+    struct endsched_args {
+      name org;
+      symbol agg_symbol;
+    };
+
+    struct settopk_args {
+      name org;
+      symbol agg_symbol;
+      uint16_t k;
+    };
+
     struct addbadgefa_args {
       name org;
       symbol agg_symbol;
@@ -217,10 +240,9 @@ CONTRACT bamanager : public contract {
       vector<symbol> badge_symbols;
     };
 
-    struct addfeature_args {
+    struct addfeatures_args {
       name org;
-      symbol badge_symbol;
-      name notify_account;
+      vector<pair<symbol, name>> features;
       string memo;
     };
 
@@ -4,33 +4,50 @@
 #include <string>
 #include <eosio/crypto.hpp>
 #include <eosio/system.hpp>
+#include <eosio/singleton.hpp>
 #include "orginterface.hpp"
 #include "authorityinterface.hpp"
+#include "subscriptioninterface.hpp"
+#include "boundedagginterface.hpp"
+#include <json.hpp>
 
 using namespace eosio;
 using namespace std;
 using namespace org_contract;
 using namespace authority_contract;
+using namespace subscription_contract;
+using namespace boundedagg_contract;
+using json = nlohmann::json;
 
 #define AUTHORITY_CONTRACT "authoritydev"
 #define ORG_CONTRACT "organizatdev"
 #define BADGEDATA_CONTRACT "badgedatadev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
 #define BOUNDED_AGG_CONTRACT "boundedagdev"
+#define BOUNDED_STATS_CONTRACT "boundedstdev"
 
-#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyachiev"
+#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyissue"
+#define BATCH_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifybatch"
 
 CONTRACT boundedagg : public contract {
 public:
     using contract::contract;
 
-    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyachiev(
+    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyissue(
+    uint8_t version,
     name org,
     asset badge_asset, 
     name from, 
     name to, 
-    string memo, 
-    vector<name> notify_accounts);
+    uint64_t issuance_seq, 
+    std::optional<uint64_t> balance);
+
+    [[eosio::on_notify(BATCH_ISSUANCE_NOTIFICATION)]] void notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo);
 
 
     ACTION initagg(name org, symbol agg_symbol, vector<symbol> init_badge_symbols, string ipfs_image, string display_name, string description);
@@ -67,80 +84,255 @@ public:
         symbol agg_symbol, 
         string key, 
         string value);
+
+    ACTION offckvpatch(name org, symbol agg_symbol, vector<kvop> ops);
+    ACTION onckvpatch(name org, symbol agg_symbol, vector<kvop> ops);
+
+    struct lookup_field {
+        string section; // "user" or "system"
+        string key;
+        string value;
+    };
+
+    struct agg_view {
+        symbol agg_symbol;
+        vector<lookup_field> offchain_lookup;
+        vector<lookup_field> onchain_lookup;
+        uint64_t last_init_seq_id;
+        vector<uint64_t> init_seq_ids;
+        vector<uint64_t> active_seq_ids;
+        vector<uint64_t> end_seq_ids;
+        vector<symbol> init_badge_symbols;
+    };
+
+    [[eosio::action, eosio::read_only]] agg_view getagg(name org, symbol agg_symbol);
+
+    ACTION migratekeys(name org, uint32_t limit);
+    ACTION seedpause(name org, symbol agg_symbol, uint64_t seq_id, uint32_t limit);
+    ACTION syncstats(name org, symbol agg_symbol, vector<symbol> badge_symbols);
+
+    [[eosio::action("continue")]] void continuejob(uint64_t job_id, uint32_t max_steps);
+
+    struct job_view {
+        uint64_t job_id;
+        name org;
+        symbol agg_symbol;
+        name kind;
+        uint64_t done_steps;
+        uint64_t total_steps;
+        time_point_sec created_time;
+    };
+
+    [[eosio::action, eosio::read_only]] job_view getjob(uint64_t job_id);
+    [[eosio::action, eosio::read_only]] vector<job_view> getjobs(name org);
+
+    ACTION schedseq(name org, symbol agg_symbol, vector<symbol> badge_symbols, time_point_sec start, uint32_t length_sec, uint32_t count);
+    ACTION endsched(name org, symbol agg_symbol);
+
+    struct window_view {
+        symbol agg_symbol;
+        uint32_t count;
+        bool open;
+        uint32_t window;
+        uint64_t seq_id;
+        time_point_sec window_start;
+        time_point_sec window_end;
+    };
+
+    // The open window of a scheduled agg, or the next one to open.
+    [[eosio::action, eosio::read_only]] window_view getwindow(name org, symbol agg_symbol);
+
+    ACTION archstart(name org, symbol agg_symbol, uint64_t seq_id);
+    ACTION archrows(name org, symbol agg_symbol, uint64_t seq_id, vector<name> accounts);
+    ACTION archseal(name org, symbol agg_symbol, uint64_t seq_id);
+
+    // Checks an archived (account, badge_agg_seq_id, count) against the sealed root of its sequence.
+    // leaf_index is the leaf's position in archive order, proof the sibling hashes from the leaf up.
+    [[eosio::action, eosio::read_only]] bool verifyarch(
+        symbol agg_symbol,
+        uint64_t seq_id,
+        name account,
+        uint64_t badge_agg_seq_id,
+        uint64_t count,
+        uint64_t leaf_index,
+        vector<checksum256> proof);
     
 private:
 
-    struct [[eosio::table]] badgestatus {
-        uint64_t badge_agg_seq_id; // Primary key: Unique ID for each badge-sequence association
-        symbol agg_symbol;         // The aggregation symbol associated with this badge
-        uint64_t seq_id;           // The sequence ID this badge is associated with
-        symbol badge_symbol;       // The symbol representing the badge
-        name badge_status;         // The status of the badge (e.g., "active")
-        name seq_status;           // The status of the sequence copied from the sequence table
+    void patch_offchain_lookup(name org, symbol agg_symbol, const vector<kvop>& ops, string failure_identifier) {
+        aggdetail_table aggdetail_t(get_self(), org.value);
+        auto itr = aggdetail_t.find(agg_symbol.code().raw());
+        check(itr != aggdetail_t.end(), failure_identifier + "agg does not exist");
+
+        string patched = patch_lookup_json(itr->offchain_lookup_data, ops, failure_identifier);
+        aggdetail_t.modify(itr, get_self(), [&](auto& row) {
+            row.offchain_lookup_data = patched;
+        });
+    }
 
-        uint64_t primary_key() const { return badge_agg_seq_id; }
-        uint128_t by_agg_seq() const { return combine_keys(agg_symbol.code().raw(), seq_id); }
+    void patch_onchain_lookup(name org, symbol agg_symbol, const vector<kvop>& ops, string failure_identifier) {
+        aggdetail_table aggdetail_t(get_self(), org.value);
+        auto itr = aggdetail_t.find(agg_symbol.code().raw());
+        check(itr != aggdetail_t.end(), failure_identifier + "agg does not exist");
 
-        checksum256 by_badge_status() const {
-            // Example hashing for badge status; adjust according to actual implementation needs
-            auto data = badge_symbol.code().to_string() + badge_status.to_string() + seq_status.to_string();
-            return sha256(data.data(), data.size());
-        }
+        string patched = patch_lookup_json(itr->onchain_lookup_data, ops, failure_identifier);
+        aggdetail_t.modify(itr, get_self(), [&](auto& row) {
+            row.onchain_lookup_data = patched;
+        });
+    }
 
-        checksum256 by_agg_seq_badge() const {
-            // Example hashing for badge status; adjust according to actual implementation needs
-            auto data = agg_symbol.code().to_string() + std::to_string(seq_id) + badge_symbol.code().to_string();
-            return sha256(data.data(), data.size());
+    vector<lookup_field> flatten_lookup(const string& json_str) {
+        vector<lookup_field> fields;
+        if (json_str.empty() || !nlohmann::json::accept(json_str)) {
+            return fields;
         }
-
-        static uint128_t combine_keys(uint64_t a, uint64_t b) {
-            // Combines two 64-bit integers into a single 128-bit value for indexing purposes
-            return (static_cast<uint128_t>(a) << 64) | b;
+        nlohmann::json j = nlohmann::json::parse(json_str);
+        if (!j.is_object()) {
+            return fields;
         }
-    };
-    typedef eosio::multi_index<"badgestatus"_n, badgestatus,
-        eosio::indexed_by<"byaggseq"_n, eosio::const_mem_fun<badgestatus, uint128_t, &badgestatus::by_agg_seq>>,
-        eosio::indexed_by<"bybadgestat"_n, eosio::const_mem_fun<badgestatus, checksum256, &badgestatus::by_badge_status>>,
-        eosio::indexed_by<"aggseqbadge"_n, eosio::const_mem_fun<badgestatus, checksum256, &badgestatus::by_agg_seq_badge>>
-    > badgestatus_table;
+        for (auto& [section_name, section_obj] : j.items()) {
+            if (!section_obj.is_object()) {
+                continue;
+            }
+            for (auto& [key, value] : section_obj.items()) {
+                fields.push_back(lookup_field {
+                    .section = section_name,
+                    .key = key,
+                    .value = value.is_string() ? value.get<string>() : value.dump()
+                });
+            }
+        }
+        return fields;
+    }
 
-    checksum256 hash_active_status(const symbol& badge_symbol, const name& badge_status, const name& seq_status) {
-        // Create a data string from badge_symbol, badge_status, and seq_status
-        string data_str = badge_symbol.code().to_string() + badge_status.to_string() + seq_status.to_string();
+    static void set_pause_bit(vector<uint64_t>& bits, uint32_t position, bool paused) {
+        if (position / 64 >= bits.size()) {
+            if (!paused) {
+                return;
+            }
+            bits.resize(position / 64 + 1);
+        }
+        if (paused) {
+            bits[position / 64] |= 1ULL << (position % 64);
+        } else {
+            bits[position / 64] &= ~(1ULL << (position % 64));
+        }
+    }
 
-        // Return the sha256 hash of the concatenated string
-        return sha256(data_str.data(), data_str.size());
+    // Position of the badge in the agg, appending it the first time it is seen.
+    uint32_t badge_position(name org, const symbol& agg_symbol, const symbol& badge_symbol) {
+        aggbadges_table aggbadges_t(get_self(), org.value);
+        auto itr = aggbadges_t.find(agg_symbol.code().raw());
+        if (itr == aggbadges_t.end()) {
+            aggbadges_t.emplace(get_self(), [&](auto& row) {
+                row.agg_symbol = agg_symbol;
+                row.badge_symbols.push_back(badge_symbol);
+            });
+            return 0;
+        }
+        auto pos = std::find(itr->badge_symbols.begin(), itr->badge_symbols.end(), badge_symbol);
+        if (pos != itr->badge_symbols.end()) {
+            return pos - itr->badge_symbols.begin();
+        }
+        uint32_t position = itr->badge_symbols.size();
+        aggbadges_t.modify(itr, get_self(), [&](auto& row) {
+            row.badge_symbols.push_back(badge_symbol);
+        });
+        return position;
     }
 
-    checksum256 hash_agg_seq_badge(const symbol& agg_symbol, uint64_t seq_id, symbol badge_symbol) {
-        // Create a data string from badge_symbol, badge_status, and seq_status
-        string data_str = agg_symbol.code().to_string() + std::to_string(seq_id) + badge_symbol.code().to_string();
+    // boundedstats table, scoped by agg_symbol
+    struct statssetting {
+        symbol badge_symbol;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef eosio::multi_index<"statssetting"_n, statssetting> statssetting_table;
 
-        // Return the sha256 hash of the concatenated string
-        return sha256(data_str.data(), data_str.size());
+    bool stats_enabled(const symbol& agg_symbol, const symbol& badge_symbol) {
+        statssetting_table statssetting_t(name(BOUNDED_STATS_CONTRACT), agg_symbol.code().raw());
+        return statssetting_t.find(badge_symbol.code().raw()) != statssetting_t.end();
     }
 
-    // scoped by account
-    struct [[eosio::table]] achievements {
-        uint64_t badge_agg_seq_id;
-        uint64_t count;
+    // Adds the row to its badge's fanout list, or drops its entry once the sequence has ended.
+    void sync_fanout(name org, const badgestatus& row) {
+        bool ended = current_seq_status(get_self(), row.agg_symbol, row.seq_id) == "end"_n;
+        fanout_table fanout_t(get_self(), org.value);
+        auto itr = fanout_t.find(row.badge_symbol.code().raw());
+        if (itr == fanout_t.end() && ended) {
+            return;
+        }
+        fanoutentry entry {
+            .badge_agg_seq_id = row.badge_agg_seq_id,
+            .agg_symbol = row.agg_symbol,
+            .seq_id = row.seq_id,
+            .position = badge_position(org, row.agg_symbol, row.badge_symbol),
+            .badge_status = row.badge_status,
+            .stats = stats_enabled(row.agg_symbol, row.badge_symbol)
+        };
+        if (itr == fanout_t.end()) {
+            fanout_t.emplace(get_self(), [&](auto& f) {
+                f.badge_symbol = row.badge_symbol;
+                f.entries.push_back(entry);
+            });
+            return;
+        }
 
-        uint64_t primary_key() const { return badge_agg_seq_id; }
-    };
-    typedef eosio::multi_index<"achievements"_n, achievements> achievements_table;
+        vector<fanoutentry> entries = itr->entries;
+        auto pos = std::find_if(entries.begin(), entries.end(), [&](const auto& e) { return e.badge_agg_seq_id == row.badge_agg_seq_id; });
+        if (ended) {
+            if (pos == entries.end()) {
+                return;
+            }
+            entries.erase(pos);
+        } else if (pos == entries.end()) {
+            entries.push_back(entry);
+        } else {
+            pos->position = entry.position;
+            pos->badge_status = entry.badge_status;
+        }
 
-    // scoped by agg symbol
-    struct [[eosio::table]] sequence {
-        uint64_t seq_id;
-        name seq_status; // init, end, active
-        string sequence_description;
-        time_point_sec init_time;
-        time_point_sec active_time;
-        time_point_sec end_time;
+        if (entries.empty()) {
+            fanout_t.erase(itr);
+        } else {
+            fanout_t.modify(itr, get_self(), [&](auto& f) {
+                f.entries = entries;
+            });
+        }
+    }
 
-        uint64_t primary_key() const { return seq_id; }
-    };
-    typedef eosio::multi_index<"sequence"_n, sequence> sequence_table;
+    bool badge_status_row_exists(name org, const symbol& agg_symbol, uint64_t seq_id, const symbol& badge_symbol) {
+        badgestatus_table badgestatus_t(get_self(), org.value);
+        auto index = badgestatus_t.get_index<"aggseqbadge"_n>();
+        auto itr = index.find(badgestatus::agg_seq_badge_key(agg_symbol, seq_id, badge_symbol));
+        if (itr == index.end() && legacy_keys_pending(get_self(), org)) {
+            itr = index.find(legacy_agg_seq_badge_key(agg_symbol, seq_id, badge_symbol));
+        }
+        return itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id && itr->badge_symbol == badge_symbol;
+    }
+
+    // Takes the agg off the schedbadges rows of the given badges, erasing rows left empty.
+    void unlink_schedule(name org, const symbol& agg_symbol, const vector<symbol>& badge_symbols) {
+        schedbadge_table schedbadge_t(get_self(), org.value);
+        for (const auto& badge_symbol : badge_symbols) {
+            auto itr = schedbadge_t.find(badge_symbol.code().raw());
+            if (itr == schedbadge_t.end()) {
+                continue;
+            }
+            vector<symbol> agg_symbols = itr->agg_symbols;
+            auto pos = std::remove(agg_symbols.begin(), agg_symbols.end(), agg_symbol);
+            if (pos == agg_symbols.end()) {
+                continue;
+            }
+            agg_symbols.erase(pos, agg_symbols.end());
+            if (agg_symbols.empty()) {
+                schedbadge_t.erase(itr);
+            } else {
+                schedbadge_t.modify(itr, get_self(), [&](auto& row) {
+                    row.agg_symbols = agg_symbols;
+                });
+            }
+        }
+    }
 
     // scoped by org
     struct [[eosio::table]] aggdetail {
@@ -148,15 +340,258 @@ private:
         string offchain_lookup_data;
         string onchain_lookup_data;
         uint64_t last_init_seq_id;
-        vector<uint64_t> init_seq_ids;
-        vector<uint64_t> active_seq_ids;
-        vector<uint64_t> end_seq_ids;
+        vector<uint64_t> init_seq_ids;   // legacy, moved into seqsets on first write
+        vector<uint64_t> active_seq_ids; // legacy, moved into seqsets on first write
+        vector<uint64_t> end_seq_ids;    // legacy, moved into seqsets on first write
         vector<symbol> init_badge_symbols;
         uint64_t primary_key() const { return agg_symbol.code().raw(); }
     };
     typedef eosio::multi_index<"aggdetails"_n, aggdetail> aggdetail_table;
 
+    struct seqrange {
+        uint64_t first;
+        uint64_t last; // inclusive
+    };
+
+    // scoped by org. Seq ids per state as sorted, non-adjacent runs. Ids are handed out densely,
+    // so a state usually holds a few runs however many sequences the agg has seen.
+    struct [[eosio::table]] seqsets {
+        symbol agg_symbol;
+        vector<seqrange> init_seq_ids;
+        vector<seqrange> active_seq_ids;
+        vector<seqrange> end_seq_ids;
+        uint64_t primary_key() const { return agg_symbol.code().raw(); }
+    };
+    typedef eosio::multi_index<"seqsets"_n, seqsets> seqsets_table;
+
+    // First run ending at or after seq_id.
+    static vector<seqrange>::iterator find_run(vector<seqrange>& runs, uint64_t seq_id) {
+        return std::lower_bound(runs.begin(), runs.end(), seq_id, [](const seqrange& run, uint64_t id) { return run.last < id; });
+    }
+
+    static void insert_seq_id(vector<seqrange>& runs, uint64_t seq_id) {
+        auto itr = find_run(runs, seq_id);
+        if (itr != runs.end() && itr->first <= seq_id) {
+            return;
+        }
+        bool joins_prev = itr != runs.begin() && std::prev(itr)->last + 1 == seq_id;
+        bool joins_next = itr != runs.end() && itr->first == seq_id + 1;
+        if (joins_prev && joins_next) {
+            std::prev(itr)->last = itr->last;
+            runs.erase(itr);
+        } else if (joins_prev) {
+            std::prev(itr)->last = seq_id;
+        } else if (joins_next) {
+            itr->first = seq_id;
+        } else {
+            runs.insert(itr, seqrange { .first = seq_id, .last = seq_id });
+        }
+    }
+
+    static bool erase_seq_id(vector<seqrange>& runs, uint64_t seq_id) {
+        auto itr = find_run(runs, seq_id);
+        if (itr == runs.end() || itr->first > seq_id) {
+            return false;
+        }
+        if (itr->first == itr->last) {
+            runs.erase(itr);
+        } else if (itr->first == seq_id) {
+            itr->first++;
+        } else if (itr->last == seq_id) {
+            itr->last--;
+        } else {
+            seqrange tail { .first = seq_id + 1, .last = itr->last };
+            itr->last = seq_id - 1;
+            runs.insert(itr + 1, tail);
+        }
+        return true;
+    }
+
+    static vector<uint64_t> expand_seq_ids(const vector<seqrange>& runs) {
+        vector<uint64_t> seq_ids;
+        for (const auto& run : runs) {
+            for (uint64_t seq_id = run.first; seq_id <= run.last; seq_id++) {
+                seq_ids.push_back(seq_id);
+            }
+        }
+        return seq_ids;
+    }
+
+    // The agg's seq id runs, built from the legacy aggdetail vectors if they have not been moved yet.
+    seqsets read_seq_sets(name org, const symbol& agg_symbol, string failure_identifier) {
+        seqsets_table seqsets_t(get_self(), org.value);
+        auto itr = seqsets_t.find(agg_symbol.code().raw());
+        if (itr != seqsets_t.end()) {
+            return *itr;
+        }
 
+        aggdetail_table aggdetail_t(get_self(), org.value);
+        auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
+        check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
+        seqsets sets { .agg_symbol = agg_symbol };
+        for (const auto& seq_id : aggdetail_itr->init_seq_ids) {
+            insert_seq_id(sets.init_seq_ids, seq_id);
+        }
+        for (const auto& seq_id : aggdetail_itr->active_seq_ids) {
+            insert_seq_id(sets.active_seq_ids, seq_id);
+        }
+        for (const auto& seq_id : aggdetail_itr->end_seq_ids) {
+            insert_seq_id(sets.end_seq_ids, seq_id);
+        }
+        return sets;
+    }
+
+    // Writes the runs back; the first write for an agg also empties its legacy aggdetail vectors.
+    void store_seq_sets(name org, const seqsets& sets) {
+        seqsets_table seqsets_t(get_self(), org.value);
+        auto itr = seqsets_t.find(sets.agg_symbol.code().raw());
+        if (itr != seqsets_t.end()) {
+            seqsets_t.modify(itr, get_self(), [&](auto& row) {
+                row = sets;
+            });
+            return;
+        }
+        seqsets_t.emplace(get_self(), [&](auto& row) {
+            row = sets;
+        });
+
+        aggdetail_table aggdetail_t(get_self(), org.value);
+        auto aggdetail_itr = aggdetail_t.find(sets.agg_symbol.code().raw());
+        aggdetail_t.modify(aggdetail_itr, get_self(), [&](auto& row) {
+            row.init_seq_ids.clear();
+            row.active_seq_ids.clear();
+            row.end_seq_ids.clear();
+        });
+    }
+
+
+
+    // Steps (seq/badge pairs) addbadge works through in its own transaction; the rest is queued as a job.
+    static constexpr uint64_t ADDBADGE_CHUNK = 100;
+
+    // scoped by boundedagg contract. Bulk operations too large for one transaction, worked off
+    // through continue. next_step is a cursor into seq_ids x badge_symbols, seq-major.
+    struct [[eosio::table]] job {
+        uint64_t job_id;
+        name org;
+        symbol agg_symbol;
+        name kind; // addbadge
+        vector<uint64_t> seq_ids;
+        vector<symbol> badge_symbols;
+        uint64_t next_step;
+        uint64_t total_steps;
+        time_point_sec created_time;
+
+        uint64_t primary_key() const { return job_id; }
+        uint64_t by_org() const { return org.value; }
+    };
+    typedef eosio::multi_index<"jobs"_n, job,
+        eosio::indexed_by<"byorg"_n, eosio::const_mem_fun<job, uint64_t, &job::by_org>>
+    > jobs_table;
+
+    job_view make_job_view(const job& j) {
+        return job_view {
+            .job_id = j.job_id,
+            .org = j.org,
+            .agg_symbol = j.agg_symbol,
+            .kind = j.kind,
+            .done_steps = j.next_step,
+            .total_steps = j.total_steps,
+            .created_time = j.created_time
+        };
+    }
+
+    // Adds the missing badgestatus rows for steps [first_step, last_step) of seq_ids x badge_symbols,
+    // with one id range reserved for the whole chunk.
+    // Returns the number of rows inserted; steps whose row already exists do no work.
+    uint64_t add_badge_steps(name org, const symbol& agg_symbol, const vector<uint64_t>& seq_ids, const vector<symbol>& badge_symbols, uint64_t first_step, uint64_t last_step) {
+        sequence_table sequence_t(get_self(), agg_symbol.code().raw());
+        vector<tuple<uint64_t, symbol, name>> new_records;
+        for (uint64_t step = first_step; step < last_step; step++) {
+            uint64_t seq_id = seq_ids[step / badge_symbols.size()];
+            const symbol& badge_symbol = badge_symbols[step % badge_symbols.size()];
+            bool pending = std::any_of(new_records.begin(), new_records.end(), [&](const auto& rec) {
+                return std::get<0>(rec) == seq_id && std::get<1>(rec) == badge_symbol;
+            });
+            if (!pending && !badge_status_row_exists(org, agg_symbol, seq_id, badge_symbol)) {
+                new_records.push_back({seq_id, badge_symbol, sequence_t.get(seq_id).seq_status});
+            }
+        }
+
+        if (!new_records.empty()) {
+            uint64_t badge_agg_seq_id = reserve_badge_agg_seq_ids(new_records.size());
+            for (const auto& [seq_id, badge_symbol, seq_status] : new_records) {
+                insert_record_in_badgestatus(org, agg_symbol, seq_id, badge_symbol, seq_status, badge_agg_seq_id++);
+            }
+        }
+        return new_records.size();
+    }
+
+    static constexpr uint32_t ARCHIVE_TREE_DEPTH = 32;
+
+    // scoped by agg_symbol. Achievements of an ended sequence folded into a fixed-depth merkle tree.
+    // Leaves are sha256(pack(account, badge_agg_seq_id, count)) in ascending account order, then
+    // ascending badge_agg_seq_id; empty leaves are zero. archrows erases each row as it appends it,
+    // so every erased row is covered by the root archseal commits.
+    struct [[eosio::table]] archive {
+        uint64_t seq_id;
+        name org;
+        vector<uint64_t> badge_agg_seq_ids; // ascending
+        name last_account;
+        uint64_t leaf_count;
+        vector<checksum256> branches; // frontier of the tree being built, one slot per level
+        checksum256 root;
+        bool sealed;
+        time_point_sec sealed_time;
+
+        uint64_t primary_key() const { return seq_id; }
+    };
+    typedef eosio::multi_index<"archive"_n, archive> archive_table;
+
+    checksum256 archive_leaf(name account, uint64_t badge_agg_seq_id, uint64_t count) {
+        auto packed = eosio::pack(std::make_tuple(account, badge_agg_seq_id, count));
+        return sha256(packed.data(), packed.size());
+    }
+
+    checksum256 archive_node(const checksum256& left, const checksum256& right) {
+        auto l = left.extract_as_byte_array();
+        auto r = right.extract_as_byte_array();
+        std::array<uint8_t, 64> data;
+        std::copy(l.begin(), l.end(), data.begin());
+        std::copy(r.begin(), r.end(), data.begin() + 32);
+        return sha256(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    // Roots of all-empty subtrees, zero_hashes[h] covering 2^h empty leaves.
+    vector<checksum256> zero_hashes() {
+        vector<checksum256> zeros(ARCHIVE_TREE_DEPTH + 1);
+        for (uint32_t h = 0; h < ARCHIVE_TREE_DEPTH; h++) {
+            zeros[h + 1] = archive_node(zeros[h], zeros[h]);
+        }
+        return zeros;
+    }
+
+    // Appends a leaf to the frontier: each filled level is merged into its parent, like a binary carry.
+    void append_archive_leaf(archive& a, const checksum256& leaf) {
+        check(a.leaf_count < (1ULL << ARCHIVE_TREE_DEPTH) - 1, "archive tree is full");
+        checksum256 node = leaf;
+        uint32_t level = 0;
+        for (uint64_t size = a.leaf_count; size & 1; size >>= 1, level++) {
+            node = archive_node(a.branches[level], node);
+        }
+        a.branches[level] = node;
+        a.leaf_count++;
+    }
+
+    checksum256 archive_root(const archive& a) {
+        vector<checksum256> zeros = zero_hashes();
+        checksum256 node;
+        uint64_t size = a.leaf_count;
+        for (uint32_t h = 0; h < ARCHIVE_TREE_DEPTH; h++, size >>= 1) {
+            node = (size & 1) ? archive_node(a.branches[h], node) : archive_node(node, zeros[h]);
+        }
+        return node;
+    }
 
     // scoped by boundedagg contract
     struct [[eosio::table]] aggseqinfo {
@@ -166,90 +601,123 @@ private:
 
     typedef eosio::multi_index<"aggseqinfo"_n, aggseqinfo> aggseqinfo_tbl;
 
+    // scoped by boundedagg contract, replaces aggseqinfo
+    struct [[eosio::table]] idcounter {
+        uint64_t last_badge_agg_seq_id;
+    };
+    typedef eosio::singleton<"idcounter"_n, idcounter> idcounter_singleton;
 
-    void update_status_in_badgestatus(name org, const symbol& agg_symbol, uint64_t seq_id, const name& new_status, string failure_identifier) {
-        badgestatus_table badgestatus_t(get_self(), org.value);
-        auto index = badgestatus_t.get_index<"byaggseq"_n>();
-        auto key = badgestatus::combine_keys(agg_symbol.code().raw(), seq_id);
-        auto itr = index.find(key);
-        while(itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id) {
-            index.modify(itr, _self, [&](auto& row) {
-                row.seq_status = new_status;
-            });
-            itr++;
+
+    // Reserves count consecutive badge_agg_seq_ids with a single counter write and returns the first.
+    // Ids stay contract-wide because achievements rows are keyed by them across orgs.
+    uint64_t reserve_badge_agg_seq_ids(uint64_t count) {
+        idcounter_singleton idcounter_s(get_self(), get_self().value);
+        idcounter counter { .last_badge_agg_seq_id = 0 };
+        if (idcounter_s.exists()) {
+            counter = idcounter_s.get();
+        } else {
+            // Seed from the legacy allocator row once, then drop it.
+            aggseqinfo_tbl a_tbl(get_self(), get_self().value);
+            auto aggseqinfo = a_tbl.begin();
+            if (aggseqinfo != a_tbl.end()) {
+                counter.last_badge_agg_seq_id = aggseqinfo->last_badge_agg_seq_id;
+                a_tbl.erase(aggseqinfo);
+            }
         }
+        uint64_t first_badge_agg_seq_id = counter.last_badge_agg_seq_id + 1;
+        counter.last_badge_agg_seq_id += count;
+        idcounter_s.set(counter, get_self());
+        return first_badge_agg_seq_id;
     }
 
-    void insert_record_in_badgestatus(name org, const symbol& agg_symbol, uint64_t seq_id, const symbol& badge_symbol, const name& seq_status, string failure_identifier) {
+    void insert_record_in_badgestatus(name org, const symbol& agg_symbol, uint64_t seq_id, const symbol& badge_symbol, const name& seq_status, uint64_t badge_agg_seq_id) {
         badgestatus_table badgestatus_t(get_self(), org.value);
-        auto index = badgestatus_t.get_index<"aggseqbadge"_n>();
-        auto key = hash_agg_seq_badge(agg_symbol, seq_id, badge_symbol);
-        auto itr = index.find(key);
-        if (itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id && itr->badge_symbol == badge_symbol) {
-            return;
-        }
-
-        aggseqinfo_tbl a_tbl(get_self(), get_self().value);
-        auto aggseqinfo = a_tbl.begin();
-        uint64_t last_badge_agg_seq_id = 1;
-        if(aggseqinfo == a_tbl.end()) {
-            
-            a_tbl.emplace(get_self(), [&](auto& row) {
-                row.last_badge_agg_seq_id = 1;
-            }); 
-            
-        } else {
-            last_badge_agg_seq_id = aggseqinfo->last_badge_agg_seq_id + 1;
-            a_tbl.emplace(_self, [&](auto& row) {
-                row.last_badge_agg_seq_id = last_badge_agg_seq_id;
-            });
-            a_tbl.erase(aggseqinfo);
-            
-        }
-        
-        
         badgestatus_t.emplace(get_self(), [&](auto& row) {
-            row.badge_agg_seq_id = last_badge_agg_seq_id;
+            row.badge_agg_seq_id = badge_agg_seq_id;
             row.agg_symbol = agg_symbol;
             row.seq_id = seq_id;
             row.badge_symbol = badge_symbol;
             row.badge_status = "active"_n;
             row.seq_status = seq_status;
         });
-
+        sync_fanout(org, *badgestatus_t.find(badge_agg_seq_id));
+
+        // New rows start active even if the badge's bit was set by an earlier pause.
+        seqbadges_table seqbadges_t(get_self(), agg_symbol.code().raw());
+        auto itr = seqbadges_t.find(seq_id);
+        if (itr != seqbadges_t.end()) {
+            uint32_t position = badge_position(org, agg_symbol, badge_symbol);
+            if (pause_bit(itr->paused, position)) {
+                seqbadges_t.modify(itr, get_self(), [&](auto& row) {
+                    set_pause_bit(row.paused, position, false);
+                });
+            }
+        }
     }
 
     vector<uint64_t> all_init_seq_ids (name org, symbol agg_symbol, string failure_identifier) {
-        aggdetail_table aggdetail_t(_self, org.value);
-        auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
-
-        check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
-        vector<uint64_t> init_seq_ids = aggdetail_itr->init_seq_ids;
+        vector<uint64_t> init_seq_ids = expand_seq_ids(read_seq_sets(org, agg_symbol, failure_identifier).init_seq_ids);
         check(!init_seq_ids.empty(), failure_identifier + "No seq id in init state");
         return init_seq_ids;
     }
 
     vector<uint64_t> all_active_seq_ids (name org, symbol agg_symbol, string failure_identifier) {
-        aggdetail_table aggdetail_t(_self, org.value);
-        auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
-
-        check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
-        vector<uint64_t> active_seq_ids = aggdetail_itr->active_seq_ids;
+        vector<uint64_t> active_seq_ids = expand_seq_ids(read_seq_sets(org, agg_symbol, failure_identifier).active_seq_ids);
         check(!active_seq_ids.empty(), failure_identifier + "No seq id in active state");
         return active_seq_ids;
     }
 
-    void update_badge_status_all(name org, symbol agg_symbol, uint64_t seq_id, name status, string failure_identifier) {
-        badgestatus_table badgestatus_t(get_self(), org.value);
-        auto index = badgestatus_t.get_index<"byaggseq"_n>();
-        auto key = badgestatus::combine_keys(agg_symbol.code().raw(), seq_id);
-        auto itr = index.find(key);
-        while(itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id) {
-            index.modify(itr, _self, [&](auto& row) {
-                row.badge_status = status;
+    // scoped by agg symbol. seedpause progress on a sequence that predates pause bitmaps: the
+    // bits of the rows up to next_badge, in aggseqbadge order. Erased once seqbadges has the row.
+    struct [[eosio::table]] pauseseed {
+        uint64_t seq_id;
+        uint64_t next_badge; // raw symbol code of the next badge to look at
+        vector<uint64_t> paused;
+        uint64_t primary_key() const { return seq_id; }
+    };
+    typedef eosio::multi_index<"pauseseed"_n, pauseseed> pauseseed_table;
+
+    // Pause bitmap of the sequence. Sequences get an empty one from initseq; older ones are
+    // seeded by seedpause, which gives every row a position on the way, so a seeded sequence
+    // has no row without one.
+    vector<uint64_t> load_pause_bits(const symbol& agg_symbol, uint64_t seq_id, string failure_identifier) {
+        seqbadges_table seqbadges_t(get_self(), agg_symbol.code().raw());
+        auto itr = seqbadges_t.find(seq_id);
+        check(itr != seqbadges_t.end(), failure_identifier + "pause bitmap of sequence not seeded, run seedpause first");
+        return itr->paused;
+    }
+
+    void store_pause_bits(const symbol& agg_symbol, uint64_t seq_id, const vector<uint64_t>& bits) {
+        seqbadges_table seqbadges_t(get_self(), agg_symbol.code().raw());
+        auto itr = seqbadges_t.find(seq_id);
+        if (itr == seqbadges_t.end()) {
+            seqbadges_t.emplace(get_self(), [&](auto& row) {
+                row.seq_id = seq_id;
+                row.paused = bits;
             });
-            itr++;
+        } else {
+            seqbadges_t.modify(itr, get_self(), [&](auto& row) {
+                row.paused = bits;
+            });
+        }
+    }
+
+    void update_badge_status_all(name org, symbol agg_symbol, uint64_t seq_id, name status, string failure_identifier) {
+        sequence_table sequence_t(get_self(), agg_symbol.code().raw());
+        check(sequence_t.find(seq_id) != sequence_t.end(), failure_identifier + "Sequence ID does not exist.");
+
+        // Every row of a seeded sequence has a position, so setting the first n bits covers them all.
+        vector<uint64_t> bits = load_pause_bits(agg_symbol, seq_id, failure_identifier);
+        bits.clear();
+        if (status == "paused"_n) {
+            aggbadges_table aggbadges_t(get_self(), org.value);
+            auto itr = aggbadges_t.find(agg_symbol.code().raw());
+            uint32_t count = itr == aggbadges_t.end() ? 0 : itr->badge_symbols.size();
+            for (uint32_t position = 0; position < count; position++) {
+                set_pause_bit(bits, position, true);
+            }
         }
+        store_pause_bits(agg_symbol, seq_id, bits);
     }
 
     void update_badge_status(name org, symbol agg_symbol, uint64_t badge_agg_seq_id, name status, string failure_identifier) {
@@ -257,28 +725,99 @@ private:
         auto itr = badgestatus_t.find(badge_agg_seq_id);
         check(itr != badgestatus_t.end(), failure_identifier + "invalid badge_seq_id");
         check(itr->agg_symbol == agg_symbol, failure_identifier + "agg_symbol mismatch");
-        badgestatus_t.modify(itr, _self, [&](auto& row) {
-            row.badge_status = status;
-        });
+        uint64_t seq_id = itr->seq_id;
+        symbol badge_symbol = itr->badge_symbol;
+
+        vector<uint64_t> bits = load_pause_bits(agg_symbol, seq_id, failure_identifier);
+        set_pause_bit(bits, badge_position(org, agg_symbol, badge_symbol), status != "active"_n);
+        store_pause_bits(agg_symbol, seq_id, bits);
     }
 
+    // Badges never added to the agg have no position and are skipped, as before they had no row.
     void update_badge_statuses(name org, symbol agg_symbol, uint64_t seq_id, vector<symbol> badge_symbols, name status, string failure_identifier) {
-        badgestatus_table badgestatus_t(get_self(), org.value);
-        auto index = badgestatus_t.get_index<"aggseqbadge"_n>();
+        vector<uint64_t> bits = load_pause_bits(agg_symbol, seq_id, failure_identifier);
         for(auto i = 0; i < badge_symbols.size(); i++) {
-            auto key = hash_agg_seq_badge(agg_symbol, seq_id, badge_symbols[i]);
-            auto itr = index.find(key);
-            if(itr != index.end() && 
-                itr->agg_symbol == agg_symbol && 
-                itr->seq_id == seq_id && 
-                itr->badge_symbol == badge_symbols[i]) {
-
-                index.modify(itr, _self, [&](auto& row) {
-                    row.badge_status = status;
-                });
+            std::optional<uint32_t> position = find_badge_position(get_self(), org, agg_symbol, badge_symbols[i]);
+            if(position) {
+                set_pause_bit(bits, *position, status != "active"_n);
+            }
+        }
+        store_pause_bits(agg_symbol, seq_id, bits);
+    }
 
+    // Resolves the badge's fanout list against the sequence and pause state, plus the open
+    // windows of scheduled aggs and, until migratekeys is done, the rows not yet in the list.
+    // Entries of sequences that have ended are dropped here, as endseq does not visit them.
+    // Each entry costs a sequence read and a seqbadges read; the fanout row is rewritten only
+    // on the first issuance after one of its sequences ended.
+    vector<seqbadge> active_seq_badges(name org, const symbol& badge_symbol) {
+        vector<symbol> closed;
+        vector<seqbadge> seq_badges = scheduled_seq_badges(get_self(), org, badge_symbol, &closed);
+        for (const auto& agg_symbol : closed) {
+            unlink_schedule(org, agg_symbol, { badge_symbol });
+        }
+        if (legacy_keys_pending(get_self(), org)) {
+            for (const auto& row : legacy_active_rows(get_self(), org, badge_symbol)) {
+                seq_badges.push_back(seqbadge { .badge_agg_seq_id = row.badge_agg_seq_id, .agg_symbol = row.agg_symbol, .seq_id = row.seq_id });
+            }
+        }
+
+        fanout_table fanout_t(get_self(), org.value);
+        auto itr = fanout_t.find(badge_symbol.code().raw());
+        if (itr == fanout_t.end()) {
+            return seq_badges;
+        }
+        vector<fanoutentry> live;
+        for (const auto& entry : itr->entries) {
+            name seq_status = current_seq_status(get_self(), entry.agg_symbol, entry.seq_id);
+            if (seq_status == "end"_n) {
+                continue;
+            }
+            live.push_back(entry);
+            if (seq_status == "active"_n && !badge_paused(get_self(), entry.agg_symbol, entry.seq_id, entry.position, entry.badge_status)) {
+                seq_badges.push_back(seqbadge { .badge_agg_seq_id = entry.badge_agg_seq_id, .agg_symbol = entry.agg_symbol, .seq_id = entry.seq_id });
             }
         }
+        if (live.empty()) {
+            fanout_t.erase(itr);
+        } else if (live.size() != itr->entries.size()) {
+            fanout_t.modify(itr, get_self(), [&](auto& f) {
+                f.entries = live;
+            });
+        }
+        return seq_badges;
+    }
+
+    void add_achievement(name to, const seqbadge& ref, int64_t amount) {
+        uint64_t count = amount;
+        achievements_table achievements(get_self(), to.value);
+        auto ach_itr = achievements.find(ref.badge_agg_seq_id);
+        if(ach_itr != achievements.end()) {
+            count += ach_itr->count;
+            achievements.erase(ach_itr);
+        }
+
+        achpack_table achpacks(get_self(), to.value);
+        auto index = achpacks.get_index<"byaggseq"_n>();
+        auto itr = index.find(badgestatus::combine_keys(ref.agg_symbol.code().raw(), ref.seq_id));
+        if(itr == index.end()) {
+            achpacks.emplace(get_self(), [&](auto& row) {
+                row.id = achpacks.available_primary_key();
+                row.agg_symbol = ref.agg_symbol;
+                row.seq_id = ref.seq_id;
+                row.counts.push_back(achcount { .badge_agg_seq_id = ref.badge_agg_seq_id, .count = count });
+            });
+            return;
+        }
+        index.modify(itr, get_self(), [&](auto& row) {
+            auto pos = std::lower_bound(row.counts.begin(), row.counts.end(), ref.badge_agg_seq_id,
+                [](const achcount& c, uint64_t id) { return c.badge_agg_seq_id < id; });
+            if(pos != row.counts.end() && pos->badge_agg_seq_id == ref.badge_agg_seq_id) {
+                pos->count += count;
+            } else {
+                row.counts.insert(pos, achcount { .badge_agg_seq_id = ref.badge_agg_seq_id, .count = count });
+            }
+        });
     }
 
     struct actseq_args {
@@ -313,9 +852,4 @@ private:
     };
 
 
-    struct billing_args {
-      name org;
-      uint8_t actions_used;
-    };
-
 };
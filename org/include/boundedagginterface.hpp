@@ -3,35 +3,40 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 #include <string>
+#include <eosio/crypto.hpp>
+#include <eosio/system.hpp>
+#include <eosio/singleton.hpp>
 
 using namespace eosio;
 using namespace std;
 
 #define BOUNDED_AGG_CONTRACT "boundedagdev"
 
+// The tables below are boundedagg's own: the contract includes this header and reads and writes
+// them through these definitions, and the contract attribute keeps them in its ABI alone.
 namespace boundedagg_contract {
     // scoped by org
-    struct [[eosio::table]] badgestatus {
+    struct [[eosio::table, eosio::contract("boundedagg")]] badgestatus {
         uint64_t badge_agg_seq_id; // Primary key: Unique ID for each badge-sequence association
         symbol agg_symbol;         // The aggregation symbol associated with this badge
         uint64_t seq_id;           // The sequence ID this badge is associated with
         symbol badge_symbol;       // The symbol representing the badge
-        name badge_status;         // The status of the badge (e.g., "active")
-        name seq_status;           // The status of the sequence copied from the sequence table
+        name badge_status;         // The status of the badge (e.g., "active"), last set for this row alone
+        name seq_status;           // The status of the sequence when the row was added; the sequence table is authoritative
 
         uint64_t primary_key() const { return badge_agg_seq_id; }
         uint128_t by_agg_seq() const { return combine_keys(agg_symbol.code().raw(), seq_id); }
 
-        checksum256 by_badge_status() const {
-            // Example hashing for badge status; adjust according to actual implementation needs
-            auto data = badge_symbol.code().to_string() + badge_status.to_string() + seq_status.to_string();
-            return sha256(data.data(), data.size());
+        checksum256 by_badge_status() const { return badge_status_key(badge_symbol, badge_status, seq_status); }
+        checksum256 by_agg_seq_badge() const { return agg_seq_badge_key(agg_symbol, seq_id, badge_symbol); }
+
+        // Fixed-layout keys: the fields are packed word by word, no hashing. Equal keys mean equal fields.
+        static checksum256 badge_status_key(const symbol& badge_symbol, const name& badge_status, const name& seq_status) {
+            return checksum256::make_from_word_sequence<uint64_t>(badge_symbol.code().raw(), badge_status.value, seq_status.value, 0ULL);
         }
 
-        checksum256 by_agg_seq_badge() const {
-            // Example hashing for badge status; adjust according to actual implementation needs
-            auto data = agg_symbol.code().to_string() + std::to_string(seq_id) + badge_symbol.code().to_string();
-            return sha256(data.data(), data.size());
+        static checksum256 agg_seq_badge_key(const symbol& agg_symbol, uint64_t seq_id, const symbol& badge_symbol) {
+            return checksum256::make_from_word_sequence<uint64_t>(agg_symbol.code().raw(), seq_id, badge_symbol.code().raw(), 0ULL);
         }
 
         static uint128_t combine_keys(uint64_t a, uint64_t b) {
@@ -45,28 +50,318 @@ namespace boundedagg_contract {
         eosio::indexed_by<"aggseqbadge"_n, eosio::const_mem_fun<badgestatus, checksum256, &badgestatus::by_agg_seq_badge>>
     > badgestatus_table;
 
-    checksum256 hash_active_status(const symbol& badge_symbol, const name& badge_status, const name& seq_status) {
-        // Create a data string from badge_symbol, badge_status, and seq_status
-        string data_str = badge_symbol.code().to_string() + badge_status.to_string() + seq_status.to_string();
+    // scoped by org. Rows written before the packed keys still carry sha256-of-string
+    // secondary keys until migratekeys has rewritten them. migratekeys also adds them to the
+    // fanout lists, so those are complete once done is set.
+    struct [[eosio::table, eosio::contract("boundedagg")]] keymigration {
+        uint64_t next_badge_agg_seq_id;
+        bool done;
+    };
+    typedef eosio::singleton<"keymigration"_n, keymigration> keymigration_singleton;
 
-        // Return the sha256 hash of the concatenated string
+    // Legacy key derivations, only used to find rows that have not been migrated yet.
+    checksum256 legacy_badge_status_key(const symbol& badge_symbol, const name& badge_status, const name& seq_status) {
+        string data_str = badge_symbol.code().to_string() + badge_status.to_string() + seq_status.to_string();
         return sha256(data_str.data(), data_str.size());
     }
 
-    checksum256 hash_agg_seq_badge(const symbol& agg_symbol, uint64_t seq_id, symbol badge_symbol) {
-        // Create a data string from badge_symbol, badge_status, and seq_status
+    checksum256 legacy_agg_seq_badge_key(const symbol& agg_symbol, uint64_t seq_id, symbol badge_symbol) {
         string data_str = agg_symbol.code().to_string() + std::to_string(seq_id) + badge_symbol.code().to_string();
-
-        // Return the sha256 hash of the concatenated string
         return sha256(data_str.data(), data_str.size());
     }
 
+    bool legacy_keys_pending(name code, name org) {
+        keymigration_singleton keymigration_s(code, org.value);
+        return !keymigration_s.exists() || !keymigration_s.get().done;
+    }
+
+    struct fanoutentry {
+        uint64_t badge_agg_seq_id;
+        symbol agg_symbol;
+        uint64_t seq_id;
+        uint32_t position; // the badge's bit in the sequence's seqbadges bitmap
+        name badge_status; // the row's badge_status, only used while the sequence has no bitmap
+        bool stats; // boundedstats is activated for this agg and badge
+    };
+
+    // scoped by org. Every badge_agg_seq_id of the badge in a sequence that has not ended,
+    // kept in step with badgestatus so an issuance reads one row instead of scanning the index.
+    // Rows are added as they are written or migrated, so while legacy_keys_pending holds for the
+    // org the list lacks only the rows legacy_active_rows finds. Sequence and pause state is
+    // resolved when the list is read.
+    struct [[eosio::table, eosio::contract("boundedagg")]] fanout {
+        symbol badge_symbol;
+        vector<fanoutentry> entries;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef eosio::multi_index<"fanout"_n, fanout> fanout_table;
+
+    // scoped by agg symbol
+    struct [[eosio::table, eosio::contract("boundedagg")]] sequence {
+        uint64_t seq_id;
+        name seq_status; // init, end, active
+        string sequence_description;
+        time_point_sec init_time;
+        time_point_sec active_time;
+        time_point_sec end_time;
+
+        uint64_t primary_key() const { return seq_id; }
+    };
+    typedef eosio::multi_index<"sequence"_n, sequence> sequence_table;
+
+    // scoped by org. Every badge ever added to the agg, its index being its bit in seqbadges.
+    // Append only, so positions never move.
+    struct [[eosio::table, eosio::contract("boundedagg")]] aggbadges {
+        symbol agg_symbol;
+        vector<symbol> badge_symbols;
+        uint64_t primary_key() const { return agg_symbol.code().raw(); }
+    };
+    typedef eosio::multi_index<"aggbadges"_n, aggbadges> aggbadges_table;
+
+    // scoped by agg_symbol. Pause bitmap of a sequence, bit i standing for the agg's badge at
+    // position i. Once a sequence has a row, pause state lives only here and badgestatus rows
+    // keep their last badge_status untouched.
+    struct [[eosio::table, eosio::contract("boundedagg")]] seqbadges {
+        uint64_t seq_id;
+        vector<uint64_t> paused;
+        uint64_t primary_key() const { return seq_id; }
+    };
+    typedef eosio::multi_index<"seqbadges"_n, seqbadges> seqbadges_table;
+
+    // A badge_agg_seq_id with the (agg, seq) it belongs to, which locates its achpack row.
+    struct seqbadge {
+        uint64_t badge_agg_seq_id;
+        symbol agg_symbol;
+        uint64_t seq_id;
+    };
+
+    // scoped by agg symbol. A run of sequences that roll over on a fixed schedule. Window w opens at
+    // start + w * length_sec, is seq_id first_seq_id + w, and badge i of it is badge_agg_seq_id
+    // first_badge_agg_seq_id + w * badge_symbols.size() + i. The open window is worked out from
+    // the clock, so nothing is written when a window opens or closes. Rows stay once their windows
+    // have closed as the record of those seq ids; only the last row of an agg can still open windows.
+    struct [[eosio::table, eosio::contract("boundedagg")]] schedule {
+        symbol agg_symbol;
+        vector<symbol> badge_symbols;
+        time_point_sec start;
+        uint32_t length_sec;
+        uint32_t count;
+        uint64_t first_seq_id;
+        uint64_t first_badge_agg_seq_id;
+        uint64_t primary_key() const { return first_seq_id; }
+    };
+    typedef eosio::multi_index<"schedules"_n, schedule> schedule_table;
+
+    // scoped by org. Aggs whose last schedule counts the badge and has windows still to close.
+    struct [[eosio::table, eosio::contract("boundedagg")]] schedbadge {
+        symbol badge_symbol;
+        vector<symbol> agg_symbols;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef eosio::multi_index<"schedbadges"_n, schedbadge> schedbadge_table;
+
+    std::optional<uint32_t> open_window(const schedule& sched, time_point_sec now) {
+        if (now < sched.start) {
+            return std::nullopt;
+        }
+        uint64_t window = (now.sec_since_epoch() - sched.start.sec_since_epoch()) / sched.length_sec;
+        if (window >= sched.count) {
+            return std::nullopt;
+        }
+        return window;
+    }
+
+    bool schedule_closed(const schedule& sched, time_point_sec now) {
+        return now.sec_since_epoch() >= sched.start.sec_since_epoch() + uint64_t(sched.count) * sched.length_sec;
+    }
+
+    // init before the window opens, active while it is open, end once it has closed.
+    name window_status(const schedule& sched, uint32_t window, time_point_sec now) {
+        uint64_t window_start = sched.start.sec_since_epoch() + uint64_t(window) * sched.length_sec;
+        if (now.sec_since_epoch() < window_start) {
+            return "init"_n;
+        }
+        return now.sec_since_epoch() < window_start + sched.length_sec ? "active"_n : "end"_n;
+    }
+
+    seqbadge window_seq_badge(const schedule& sched, uint32_t window, uint64_t badge_index) {
+        return seqbadge {
+            .badge_agg_seq_id = sched.first_badge_agg_seq_id + window * sched.badge_symbols.size() + badge_index,
+            .agg_symbol = sched.agg_symbol,
+            .seq_id = sched.first_seq_id + window
+        };
+    }
+
+    // The schedule whose windows include seq_id, if any.
+    std::optional<schedule> find_schedule(name code, const symbol& agg_symbol, uint64_t seq_id) {
+        schedule_table schedule_t(code, agg_symbol.code().raw());
+        auto itr = schedule_t.upper_bound(seq_id);
+        if (itr == schedule_t.begin()) {
+            return std::nullopt;
+        }
+        --itr;
+        if (seq_id >= itr->first_seq_id + itr->count) {
+            return std::nullopt;
+        }
+        return *itr;
+    }
+
+    // The agg's most recent schedule, the only one that can still have windows to open.
+    std::optional<schedule> last_schedule(name code, const symbol& agg_symbol) {
+        schedule_table schedule_t(code, agg_symbol.code().raw());
+        auto itr = schedule_t.end();
+        if (itr == schedule_t.begin()) {
+            return std::nullopt;
+        }
+        --itr;
+        return *itr;
+    }
+
+    // Refs of the badge in the currently open window of each scheduled agg counting it. Aggs
+    // whose schedule has closed are added to closed, if given, so the contract can unlink them.
+    vector<seqbadge> scheduled_seq_badges(name code, name org, const symbol& badge_symbol, vector<symbol>* closed = nullptr) {
+        vector<seqbadge> seq_badges;
+        schedbadge_table schedbadge_t(code, org.value);
+        auto itr = schedbadge_t.find(badge_symbol.code().raw());
+        if (itr == schedbadge_t.end()) {
+            return seq_badges;
+        }
+        time_point_sec now = time_point_sec(current_time_point());
+        for (const auto& agg_symbol : itr->agg_symbols) {
+            std::optional<schedule> sched = last_schedule(code, agg_symbol);
+            if (!sched || schedule_closed(*sched, now)) {
+                if (closed) {
+                    closed->push_back(agg_symbol);
+                }
+                continue;
+            }
+            std::optional<uint32_t> window = open_window(*sched, now);
+            if (!window) {
+                continue;
+            }
+            auto pos = std::find(sched->badge_symbols.begin(), sched->badge_symbols.end(), badge_symbol);
+            seq_badges.push_back(window_seq_badge(*sched, *window, pos - sched->badge_symbols.begin()));
+        }
+        return seq_badges;
+    }
+
+    bool pause_bit(const vector<uint64_t>& bits, uint32_t position) {
+        return position / 64 < bits.size() && ((bits[position / 64] >> (position % 64)) & 1);
+    }
+
+    name current_seq_status(name code, const symbol& agg_symbol, uint64_t seq_id) {
+        sequence_table sequence_t(code, agg_symbol.code().raw());
+        auto itr = sequence_t.find(seq_id);
+        if (itr != sequence_t.end()) {
+            return itr->seq_status;
+        }
+        // Scheduled windows have no sequence row, their status follows from the clock.
+        std::optional<schedule> sched = find_schedule(code, agg_symbol, seq_id);
+        if (!sched) {
+            return "end"_n;
+        }
+        return window_status(*sched, seq_id - sched->first_seq_id, time_point_sec(current_time_point()));
+    }
+
+    std::optional<uint32_t> find_badge_position(name code, name org, const symbol& agg_symbol, const symbol& badge_symbol) {
+        aggbadges_table aggbadges_t(code, org.value);
+        auto itr = aggbadges_t.find(agg_symbol.code().raw());
+        if (itr == aggbadges_t.end()) {
+            return std::nullopt;
+        }
+        auto pos = std::find(itr->badge_symbols.begin(), itr->badge_symbols.end(), badge_symbol);
+        if (pos == itr->badge_symbols.end()) {
+            return std::nullopt;
+        }
+        return pos - itr->badge_symbols.begin();
+    }
+
+    // The sequence's bitmap once it has one, before that the row's own badge_status.
+    bool badge_paused(name code, const symbol& agg_symbol, uint64_t seq_id, std::optional<uint32_t> position, const name& badge_status) {
+        seqbadges_table seqbadges_t(code, agg_symbol.code().raw());
+        auto itr = seqbadges_t.find(seq_id);
+        if (itr == seqbadges_t.end() || !position) {
+            return badge_status != "active"_n;
+        }
+        return pause_bit(itr->paused, *position);
+    }
+
+    // Reads the entry's sequence row and its seqbadges row. The sequence status is not cached
+    // in the entry so that actseq and endseq stay one write per sequence.
+    bool fanout_entry_active(name code, const fanoutentry& entry) {
+        return current_seq_status(code, entry.agg_symbol, entry.seq_id) == "active"_n &&
+            !badge_paused(code, entry.agg_symbol, entry.seq_id, entry.position, entry.badge_status);
+    }
+
+    // Rows of the badge that still carry legacy sha256 keys and are active in an active sequence.
+    // These are the rows migratekeys has not reached, so the fanout list does not hold them yet;
+    // every other row of the badge outside an ended sequence is in the list. Rows that were in an
+    // ended sequence before the keys changed are not looked up. The other stored statuses are only
+    // a prefilter since sequence and pause changes no longer rewrite rows.
+    vector<badgestatus> legacy_active_rows(name code, name org, const symbol& badge_symbol) {
+        badgestatus_table badgestatus_t(code, org.value);
+        auto by_status_index = badgestatus_t.get_index<"bybadgestat"_n>();
+        vector<badgestatus> rows;
+        for (const auto& badge_status : { "active"_n, "paused"_n }) {
+            for (const auto& seq_status : { "init"_n, "active"_n }) {
+                auto itr = by_status_index.find(legacy_badge_status_key(badge_symbol, badge_status, seq_status));
+                for (; itr != by_status_index.end() && itr->badge_symbol == badge_symbol && itr->badge_status == badge_status && itr->seq_status == seq_status; ++itr) {
+                    if (current_seq_status(code, itr->agg_symbol, itr->seq_id) == "active"_n &&
+                        !badge_paused(code, itr->agg_symbol, itr->seq_id, find_badge_position(code, org, itr->agg_symbol, itr->badge_symbol), itr->badge_status)) {
+                        rows.push_back(*itr);
+                    }
+                }
+            }
+        }
+        return rows;
+    }
+
     // scoped by account
-    struct [[eosio::table]] achievements {
+    struct [[eosio::table, eosio::contract("boundedagg")]] achievements {
         uint64_t badge_agg_seq_id;
         uint64_t count;
 
         uint64_t primary_key() const { return badge_agg_seq_id; }
     };
     typedef eosio::multi_index<"achievements"_n, achievements> achievements_table;
+
+    struct achcount {
+        uint64_t badge_agg_seq_id;
+        uint64_t count;
+    };
+
+    // scoped by account. All counts of one (agg, seq) in a single row, sorted by badge_agg_seq_id.
+    // Takes over from achievements: a legacy row is folded in the next time its count changes.
+    struct [[eosio::table, eosio::contract("boundedagg")]] achpack {
+        uint64_t id;
+        symbol agg_symbol;
+        uint64_t seq_id;
+        vector<achcount> counts;
+
+        uint64_t primary_key() const { return id; }
+        uint128_t by_agg_seq() const { return (static_cast<uint128_t>(agg_symbol.code().raw()) << 64) | seq_id; }
+    };
+    typedef eosio::multi_index<"achpacks"_n, achpack,
+        eosio::indexed_by<"byaggseq"_n, eosio::const_mem_fun<achpack, uint128_t, &achpack::by_agg_seq>>
+    > achpack_table;
+
+    // Current count of a badge_agg_seq_id for the account, from its achpack row or a legacy achievements row.
+    std::optional<uint64_t> achievement_count(name code, name account, const seqbadge& ref) {
+        achpack_table achpacks(code, account.value);
+        auto index = achpacks.get_index<"byaggseq"_n>();
+        auto itr = index.find(badgestatus::combine_keys(ref.agg_symbol.code().raw(), ref.seq_id));
+        if (itr != index.end()) {
+            for (const auto& c : itr->counts) {
+                if (c.badge_agg_seq_id == ref.badge_agg_seq_id) {
+                    return c.count;
+                }
+            }
+        }
+        achievements_table achievements(code, account.value);
+        auto ach_itr = achievements.find(ref.badge_agg_seq_id);
+        if (ach_itr != achievements.end()) {
+            return ach_itr->count;
+        }
+        return std::nullopt;
+    }
 }
@@ -3,11 +3,15 @@
 #include <eosio/crypto.hpp>
 #include "authorityinterface.hpp"
 #include "boundedagginterface.hpp"
+#include "subscriptioninterface.hpp"
+#include "statsinterface.hpp"
 
 using namespace std;
 using namespace eosio;
 using namespace authority_contract;
 using namespace boundedagg_contract;
+using namespace subscription_contract;
+using namespace stats_contract;
 
 #define BADGEDATA_CONTRACT "badgedatadev"
 #define BOUNDED_AGG_CONTRACT "boundedagdev"
@@ -15,25 +19,42 @@ using namespace boundedagg_contract;
 #define ORG_CONTRACT "organizatdev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
 
-#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyachiev"
+#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyissue"
+#define BATCH_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifybatch"
 
 CONTRACT boundedstats : public contract {
   public:
     using contract::contract;
 
-    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyachiev(
+    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyissue(
+        uint8_t version,
         name org,
         asset badge_asset, 
         name from, 
         name to, 
-        string memo, 
-        vector<name> notify_accounts);
+        uint64_t issuance_seq, 
+        std::optional<uint64_t> balance);
+
+    [[eosio::on_notify(BATCH_ISSUANCE_NOTIFICATION)]] void notifybatch(
+        name org,
+        symbol badge_symbol,
+        name from,
+        vector<pair<name, int64_t>> recipients,
+        string memo);
 
 
     ACTION activate(name org, symbol agg_symbol, vector<symbol> badge_symbols);
 
     ACTION deactivate(name org, symbol agg_symbol, vector<symbol> badge_symbols);
 
+    ACTION settopk(name org, symbol agg_symbol, uint16_t k);
+
+    ACTION backfillhist(name org, symbol agg_symbol, uint64_t badge_agg_seq_id, uint32_t limit);
+
+    // Approximate balance percentiles within a badge_agg_seq_id, as the bounds of the
+    // histogram bucket each falls in.
+    [[eosio::action, eosio::read_only]] vector<percentile_view> percentiles(name org, uint64_t badge_agg_seq_id, vector<uint8_t> percentiles);
+
   private:
     //scoped by agg_symbol
     TABLE  statssetting {
@@ -91,6 +112,137 @@ CONTRACT boundedstats : public contract {
 
     }
 
+    // scoped by org. Aggs in top-K mode and their k; their sequences keep a leaderboard instead of ranks.
+    TABLE topk {
+        symbol agg_symbol;
+        uint16_t k;
+        uint64_t primary_key() const { return agg_symbol.code().raw(); }
+    };
+    typedef multi_index<"topk"_n, topk> topk_table;
+
+    // scoped by org. The k highest balances of a badge_agg_seq_id, highest first.
+    TABLE leaderboard {
+        uint64_t badge_agg_seq_id;
+        vector<leader> leaders;
+        uint64_t primary_key() const { return badge_agg_seq_id; }
+    };
+    typedef multi_index<"leaderboard"_n, leaderboard> leaderboard_table;
+
+    // A sequence's board starts from the top of its ranks, which are current up to the
+    // first issuance after top-K mode was turned on.
+    vector<leader> seed_leaders(uint64_t badge_agg_seq_id, uint16_t k) {
+        ranks_table _ranks(get_self(), badge_agg_seq_id);
+        vector<leader> leaders;
+        for (auto itr = _ranks.end(); itr != _ranks.begin() && leaders.size() < k;) {
+            --itr;
+            for (auto i = 0; i < itr->accounts.size() && leaders.size() < k; i++) {
+                leaders.push_back(leader { .account = itr->accounts[i], .balance = itr->balance });
+            }
+        }
+        return leaders;
+    }
+
+    void update_leaderboard(name org, name account, uint64_t badge_agg_seq_id, uint16_t k, uint64_t balance) {
+        leaderboard_table _leaderboard(get_self(), org.value);
+        auto itr = _leaderboard.find(badge_agg_seq_id);
+        if (itr == _leaderboard.end()) {
+            itr = _leaderboard.emplace(get_self(), [&](auto& entry) {
+                entry.badge_agg_seq_id = badge_agg_seq_id;
+                entry.leaders = seed_leaders(badge_agg_seq_id, k);
+            });
+        }
+        vector<leader> leaders = itr->leaders;
+        if (!place_leader(leaders, k, account, balance)) {
+            return;
+        }
+        _leaderboard.modify(itr, get_self(), [&](auto& entry) {
+            entry.leaders = leaders;
+        });
+    }
+
+    uint16_t topk_size(name org, const symbol& agg_symbol) {
+        topk_table _topk(get_self(), org.value);
+        auto itr = _topk.find(agg_symbol.code().raw());
+        return itr == _topk.end() ? 0 : itr->k;
+    }
+
+    // scoped by org. Holder count per log-scale balance bucket. Until backfilled, only accounts
+    // listed in histcounted are in the buckets; backfillhist walks ranks from next_balance to
+    // add the rest.
+    TABLE histogram {
+        uint64_t badge_agg_seq_id;
+        vector<uint64_t> buckets;
+        uint64_t next_balance;
+        bool backfilled;
+        uint64_t primary_key() const { return badge_agg_seq_id; }
+    };
+    typedef multi_index<"histogram"_n, histogram> histogram_table;
+
+    // scoped by badge_agg_seq_id. Accounts already in the histogram while it is not backfilled.
+    // Emptied by backfillhist once it is.
+    TABLE histcounted {
+        name account;
+        uint64_t primary_key() const { return account.value; }
+    };
+    typedef multi_index<"histcounted"_n, histcounted> histcounted_table;
+
+    // Marks the account as counted, returning whether it already was.
+    bool mark_counted(uint64_t badge_agg_seq_id, name account) {
+        histcounted_table _histcounted(get_self(), badge_agg_seq_id);
+        if (_histcounted.find(account.value) != _histcounted.end()) {
+            return true;
+        }
+        _histcounted.emplace(get_self(), [&](auto& entry) {
+            entry.account = account;
+        });
+        return false;
+    }
+
+    // Whether anyone but the account may hold the badge_agg_seq_id from before its histogram
+    // existed. Aggs in top-K mode no longer list new holders in ranks, so they always may.
+    bool has_earlier_holders(name org, const symbol& agg_symbol, uint64_t badge_agg_seq_id, name account) {
+        if (topk_size(org, agg_symbol) > 0) {
+            return true;
+        }
+        ranks_table _ranks(get_self(), badge_agg_seq_id);
+        for (auto itr = _ranks.begin(); itr != _ranks.end(); itr++) {
+            if (itr->accounts.size() > 1 || itr->accounts[0] != account) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // An account is moved out of its old bucket only once it is known to be counted; otherwise
+    // it is just added and, until the histogram is backfilled, marked as counted.
+    void update_histogram(name org, name account, const seqbadge& seq_badge, uint64_t old_balance, uint64_t new_balance) {
+        histogram_table _histogram(get_self(), org.value);
+        auto itr = _histogram.find(seq_badge.badge_agg_seq_id);
+        if (itr == _histogram.end()) {
+            vector<uint64_t> buckets;
+            move_in_histogram(buckets, 0, new_balance);
+            bool backfilled = !has_earlier_holders(org, seq_badge.agg_symbol, seq_badge.badge_agg_seq_id, account);
+            if (!backfilled) {
+                mark_counted(seq_badge.badge_agg_seq_id, account);
+            }
+            _histogram.emplace(get_self(), [&](auto& entry) {
+                entry.badge_agg_seq_id = seq_badge.badge_agg_seq_id;
+                entry.buckets = buckets;
+                entry.next_balance = 0;
+                entry.backfilled = backfilled;
+            });
+            return;
+        }
+        bool counted = itr->backfilled || mark_counted(seq_badge.badge_agg_seq_id, account);
+        vector<uint64_t> buckets = itr->buckets;
+        if (!move_in_histogram(buckets, counted ? old_balance : 0, new_balance)) {
+            return;
+        }
+        _histogram.modify(itr, get_self(), [&](auto& entry) {
+            entry.buckets = buckets;
+        });
+    }
+
     void update_count(name org, name account, uint64_t badge_agg_seq_id, uint64_t old_balance, uint64_t new_balance) {
         counts_table _counts(get_self(), org.value);
         auto counts_itr = _counts.find(badge_agg_seq_id);
@@ -117,27 +269,73 @@ CONTRACT boundedstats : public contract {
         }
     }
 
-    // Function to fetch the new balance from the achievements table, scoped by account.
-    uint64_t get_new_balance(name account, uint64_t badge_agg_seq_id) {
-        // Access the achievements table with the account as the scope.
-        achievements_table achievements(name(BOUNDED_AGG_CONTRACT), account.value);
-        auto achv_itr = achievements.find(badge_agg_seq_id);
-        
-        // Check if the record exists and return the balance.
-        if (achv_itr != achievements.end()) {
-            return achv_itr->count; // Assuming 'balance' is the field storing the balance.
-        } else {
-            // Handle the case where there is no such achievement record.
-            eosio::check(false, "Achievement record not found for the given badge_agg_seq_id.");
-            return 0; // This return is formal as the check above will halt execution if triggered.
+    // Function to fetch the new balance from boundedagg's achievements, packed or legacy.
+    uint64_t get_new_balance(name account, const seqbadge& seq_badge) {
+        std::optional<uint64_t> count = achievement_count(name(BOUNDED_AGG_CONTRACT), account, seq_badge);
+        eosio::check(count.has_value(), "Achievement record not found for the given badge_agg_seq_id.");
+        return *count;
+    }
+
+    // Active badge_agg_seq_ids of the badge whose aggregate has stats enabled for it.
+    vector<seqbadge> stats_seq_badges(name org, const symbol& badge_symbol) {
+        vector<seqbadge> seq_badges;
+        for (const auto& seq_badge : scheduled_seq_badges(name(BOUNDED_AGG_CONTRACT), org, badge_symbol)) {
+            statssetting_table _statssetting(get_self(), seq_badge.agg_symbol.code().raw());
+            if(_statssetting.find(badge_symbol.code().raw()) != _statssetting.end()) {
+                seq_badges.push_back(seq_badge);
+            }
+        }
+        fanout_table fanout_t(name(BOUNDED_AGG_CONTRACT), org.value);
+        auto itr = fanout_t.find(badge_symbol.code().raw());
+        if (itr != fanout_t.end()) {
+            for (const auto& entry : itr->entries) {
+                if (entry.stats && fanout_entry_active(name(BOUNDED_AGG_CONTRACT), entry)) {
+                    seq_badges.push_back(seqbadge { .badge_agg_seq_id = entry.badge_agg_seq_id, .agg_symbol = entry.agg_symbol, .seq_id = entry.seq_id });
+                }
+            }
+        }
+        if (!legacy_keys_pending(name(BOUNDED_AGG_CONTRACT), org)) {
+            return seq_badges;
         }
+        for (const auto& row : legacy_active_rows(name(BOUNDED_AGG_CONTRACT), org, badge_symbol)) {
+            statssetting_table _statssetting(get_self(), row.agg_symbol.code().raw());
+            if(_statssetting.find(row.badge_symbol.code().raw()) != _statssetting.end()) {
+                seq_badges.push_back(seqbadge { .badge_agg_seq_id = row.badge_agg_seq_id, .agg_symbol = row.agg_symbol, .seq_id = row.seq_id });
+            }
+        }
+        return seq_badges;
     }
-    
 
+    void record_issuance(name org, name to, const seqbadge& seq_badge, int64_t amount) {
+        uint64_t new_balance = get_new_balance(to, seq_badge);
+        uint64_t old_balance = new_balance - amount;
+        uint16_t k = topk_size(org, seq_badge.agg_symbol);
+        if (k > 0) {
+            update_leaderboard(org, to, seq_badge.badge_agg_seq_id, k, new_balance);
+        } else {
+            update_rank(org, to, seq_badge.badge_agg_seq_id, old_balance, new_balance);
+        }
+        update_count(org, to, seq_badge.badge_agg_seq_id, old_balance, new_balance);
+        update_histogram(org, to, seq_badge, old_balance, new_balance);
+    }
 
-    struct billing_args {
+    struct syncstats_args {
       name org;
-      uint8_t actions_used;
+      symbol agg_symbol;
+      vector<symbol> badge_symbols;
     };
 
+    // Keeps the stats flags in boundedagg's fanout lists in step with statssetting.
+    void sync_stats(name org, symbol agg_symbol, const vector<symbol>& badge_symbols) {
+      action {
+        permission_level{get_self(), name("active")},
+        name(BOUNDED_AGG_CONTRACT),
+        name("syncstats"),
+        syncstats_args {
+          .org = org,
+          .agg_symbol = agg_symbol,
+          .badge_symbols = badge_symbols}
+      }.send();
+    }
+
 };
@@ -1,28 +1,39 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include "subscriptioninterface.hpp"
 
 using namespace std;
 using namespace eosio;
+using namespace subscription_contract;
 
 #define BADGEDATA_CONTRACT "badgedatadev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
 #define CUMULATIVE_CONTRACT "cumulativdev"
 
 
-#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyachiev"
+#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyissue"
+#define BATCH_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifybatch"
 
 
 CONTRACT cumulative : public contract {
 public:
   using contract::contract;
   
-  [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyachiev(
+  [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyissue(
+    uint8_t version,
     name org,
     asset badge_asset, 
     name from, 
     name to, 
-    string memo, 
-    vector<name> notify_accounts);
+    uint64_t issuance_seq, 
+    std::optional<uint64_t> balance);
+
+  [[eosio::on_notify(BATCH_ISSUANCE_NOTIFICATION)]] void notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo);
 
   ACTION dummy();
 
@@ -33,10 +44,23 @@ private:
   };
   typedef eosio::multi_index<"accounts"_n, account> accounts;
 
-  struct billing_args {
-    name org;
-    uint8_t actions_used;
-  };
+  void credit(name to, const asset& badge_asset) {
+    // Access the accounts table scoped by "to"
+    accounts to_accounts(get_self(), to.value);
+
+    // Find the account using the amount's symbol code
+    auto existing_account = to_accounts.find(badge_asset.symbol.code().raw());
+
+    if (existing_account == to_accounts.end()) {
+      to_accounts.emplace(get_self(), [&](auto& acc) {
+        acc.balance = badge_asset;
+      });
+    } else {
+      to_accounts.modify(existing_account, get_self(), [&](auto& acc) {
+        acc.balance += badge_asset;
+      });
+    }
+  }
 
 };
 
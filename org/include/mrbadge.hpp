@@ -2,10 +2,12 @@
 #include <eosio/asset.hpp>
 #include <eosio/system.hpp>
 #include "authorityinterface.hpp"
+#include "subscriptioninterface.hpp"
 
 using namespace std;
 using namespace eosio;
 using namespace authority_contract;
+using namespace subscription_contract;
 
 #define BADGEDATA_CONTRACT "badgedatadev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
@@ -86,9 +88,4 @@ CONTRACT mrbadge : public contract {
       string memo;
     };
 
-    struct billing_args {
-      name org;
-      uint8_t actions_used;
-    };
-
 };
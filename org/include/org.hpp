@@ -5,6 +5,7 @@ using json = nlohmann::json;
 
 
 #include "badgedatainterface.hpp"
+#include "orginterface.hpp"
 #include "authorityinterface.hpp"
 #include "andemitterinterface.hpp"
 
@@ -33,6 +34,10 @@ CONTRACT org : public contract {
 
     ACTION onckeyvalue(name org, string key, string value);    
 
+    ACTION offckvpatch(name org, vector<org_contract::kvop> ops);
+
+    ACTION onckvpatch(name org, vector<org_contract::kvop> ops);
+
     ACTION nextbadge(name org);
 
     ACTION nextemission(name org);
@@ -140,83 +145,34 @@ CONTRACT org : public contract {
 
 
     void put_offchain_key_value(name org, string key, string value) {
-        // Open the table in the contract's scope.
+        patch_offchain_lookup(org, { org_contract::kvop { .key = key, .value = value } });
+    }
+
+    void put_onchain_key_value(name org, string key, string value) {
+        patch_onchain_lookup(org, { org_contract::kvop { .key = key, .value = value } });
+    }
+
+    void patch_offchain_lookup(name org, const vector<org_contract::kvop>& ops) {
         orgs_index orgcodes(name(ORG_CONTRACT), name(ORG_CONTRACT).value);
         auto itr = orgcodes.find(org.value);
         check(itr != orgcodes.end(), "Organization does not exist");
 
-        // Retrieve the current offchain JSON string.
-        string json_str = itr->offchain_lookup_data;
-        nlohmann::json j;
-        if (json_str.empty()) {
-            // If empty, initialize as an empty JSON object.
-            j = nlohmann::json::object();
-        } else if (nlohmann::json::accept(json_str)) {
-            j = nlohmann::json::parse(json_str);
-        } else {
-            check(false, "Stored JSON is non-empty and not a valid JSON");
-        }
-        
-        // Ensure the JSON is an object.
-        check(j.is_object(), "Lookup JSON must be an object");
-
-        // Ensure the "user" tag exists and is an object.
-        if (j.find("user") == j.end() || !j["user"].is_object()) {
-            j["user"] = nlohmann::json::object();
-        }
-
-        // Disallow creating a tag named "system".
-        check(key != "system", "Cannot create tag 'system'");
-
-        // Update or insert the key/value pair under the "user" object.
-        j["user"][key] = value;
-
-        // Write the updated JSON back to the table.
+        string patched = org_contract::patch_lookup_json(itr->offchain_lookup_data, ops, "");
         orgcodes.modify(itr, same_payer, [&](auto &row) {
-            row.offchain_lookup_data = j.dump();
+            row.offchain_lookup_data = patched;
         });
     }
 
-    void put_onchain_key_value(name org, string key, string value) {
-        // Open the table in the contract's scope.
+    void patch_onchain_lookup(name org, const vector<org_contract::kvop>& ops) {
         orgs_index orgcodes(name(ORG_CONTRACT), name(ORG_CONTRACT).value);
         auto itr = orgcodes.find(org.value);
         check(itr != orgcodes.end(), "Organization does not exist");
 
-        // Retrieve the current onchain JSON string.
-        string json_str = itr->onchain_lookup_data;
-        nlohmann::json j;
-        if (json_str.empty()) {
-            // If empty, initialize as an empty JSON object.
-            j = nlohmann::json::object();
-        } else if (nlohmann::json::accept(json_str)) {
-            j = nlohmann::json::parse(json_str);
-        } else {
-            check(false, "Stored JSON is non-empty and not a valid JSON");
-        }
-        
-        // Ensure the JSON is an object.
-        check(j.is_object(), "Lookup JSON must be an object");
-
-        // Ensure the "user" tag exists and is an object.
-        if (j.find("user") == j.end() || !j["user"].is_object()) {
-            j["user"] = nlohmann::json::object();
-        }
-
-        // Disallow creating a tag named "system".
-        check(key != "system", "Cannot create tag 'system'");
-
-        // Update or insert the key/value pair under the "user" object.
-        j["user"][key] = value;
-
-        // Write the updated JSON back to the table.
+        string patched = org_contract::patch_lookup_json(itr->onchain_lookup_data, ops, "");
         orgcodes.modify(itr, same_payer, [&](auto& row) {
-            row.onchain_lookup_data = j.dump();
+            row.onchain_lookup_data = patched;
         });
     }
 
-
-
-
 };
 
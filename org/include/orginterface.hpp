@@ -2,6 +2,7 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 #include <string>
+#include <optional>
 #include "badgedatainterface.hpp"
 #include <json.hpp>
 using json = nlohmann::json;
@@ -104,6 +105,39 @@ namespace org_contract {
     }
 
 
+    // One entry of a *kvpatch action: upserts key under "user", or deletes it when value is
+    // absent. An empty string is stored as "".
+    struct kvop {
+        string key;
+        std::optional<string> value;
+    };
+
+    // Applies a whole patch to a lookup JSON blob with a single parse and a single dump.
+    string patch_lookup_json(const string& json_str, const vector<kvop>& ops, string failure_identifier) {
+        nlohmann::json j;
+        if (json_str.empty()) {
+            j = nlohmann::json::object();
+        } else if (nlohmann::json::accept(json_str)) {
+            j = nlohmann::json::parse(json_str);
+        } else {
+            check(false, failure_identifier + "Stored JSON is non-empty and not a valid JSON");
+        }
+        check(j.is_object(), failure_identifier + "Lookup JSON must be an object");
+
+        if (j.find("user") == j.end() || !j["user"].is_object()) {
+            j["user"] = nlohmann::json::object();
+        }
+        for (const auto& op : ops) {
+            check(op.key != "system", failure_identifier + "Cannot modify system tag");
+            if (op.value.has_value()) {
+                j["user"][op.key] = *op.value;
+            } else {
+                j["user"].erase(op.key);
+            }
+        }
+        return j.dump();
+    }
+
     string get_onchain_lookup_user_data(name org, string key) {
         orgs_index _orgs(name(ORG_CONTRACT), name(ORG_CONTRACT).value);
         auto itr = _orgs.find(org.value);
@@ -40,6 +40,12 @@ CONTRACT simmanager : public contract {
       vector<name> to, 
       string memo);
 
+    ACTION settopk (name authorized, symbol badge_symbol, uint16_t k);
+
+    ACTION setwindow (name authorized, symbol badge_symbol, uint32_t bucket_sec, uint16_t bucket_count);
+
+    ACTION seteventlog (name authorized, name org, uint32_t capacity);
+
     ACTION addbadgeauth (name org, name action, name badge, name authorized_account);
 
     ACTION delbadgeauth (name org, name action, name badge, name authorized_account);
@@ -105,10 +111,9 @@ CONTRACT simmanager : public contract {
       }
       return false;
     }    
-    struct addfeature_args {
+    struct addfeatures_args {
       name org;
-      symbol badge_symbol;
-      name notify_account;
+      vector<pair<symbol, name>> features;
       string memo;
     };
 
@@ -128,4 +133,34 @@ CONTRACT simmanager : public contract {
       string memo;
     };
 
+    struct issuebatch_args {
+      name org;
+      symbol badge_symbol;
+      vector<pair<name, int64_t>> recipients;
+      string memo;
+    };
+
+    struct initlifetime_args {
+      name org;
+      symbol badge_symbol;
+    };
+
+    struct settopk_args {
+      name org;
+      symbol badge_symbol;
+      uint16_t k;
+    };
+
+    struct setwindow_args {
+      name org;
+      symbol badge_symbol;
+      uint32_t bucket_sec;
+      uint16_t bucket_count;
+    };
+
+    struct seteventlog_args {
+      name org;
+      uint32_t capacity;
+    };
+
 };
@@ -1,10 +1,12 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 #include "authorityinterface.hpp"
+#include "subscriptioninterface.hpp"
 
 using namespace std;
 using namespace eosio;
 using namespace authority_contract;
+using namespace subscription_contract;
 
 #define BADGEDATA_CONTRACT "badgedatadev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
@@ -23,6 +25,8 @@ CONTRACT simplebadge : public contract {
 
     ACTION issue (name org, asset badge_asset, name to, string memo );
 
+    ACTION issuebatch (name org, symbol badge_symbol, vector<pair<name, int64_t>> recipients, string memo );
+
 
   private:
 
@@ -34,6 +38,14 @@ CONTRACT simplebadge : public contract {
       string memo;
     };
 
+    struct achievements_args {
+      name org;
+      symbol badge_symbol;
+      name from;
+      vector<pair<name, int64_t>> recipients;
+      string memo;
+    };
+
     struct initbadge_args {
       name org;
       symbol badge_symbol;
@@ -43,9 +55,4 @@ CONTRACT simplebadge : public contract {
       string memo;
     };
 
-    struct billing_args {
-      name org;
-      uint8_t actions_used;
-    };
-
 };
@@ -1,7 +1,11 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/system.hpp>
 #include "cumulativeinterface.hpp"
 #include "badgedatainterface.hpp"
+#include "authorityinterface.hpp"
+#include "subscriptioninterface.hpp"
+#include "statsinterface.hpp"
 
 #define CUMULATIVE_CONTRACT "cumulativdev"
 #define BADGEDATA_CONTRACT "badgedatadev"
@@ -9,13 +13,17 @@
 #define ORG_CONTRACT "organizatdev"
 #define SUBSCRIPTION_CONTRACT "subscribedev"
 
-#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyachiev"
+#define NEW_BADGE_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifyissue"
+#define BATCH_ISSUANCE_NOTIFICATION BADGEDATA_CONTRACT"::notifybatch"
 
 
 using namespace std;
 using namespace eosio;
 using namespace cumulative_contract;
 using namespace badgedata_contract;
+using namespace authority_contract;
+using namespace subscription_contract;
+using namespace stats_contract;
 
 CONTRACT statistics : public contract {
   public:
@@ -23,13 +31,44 @@ CONTRACT statistics : public contract {
 
     ACTION dummy();
 
-    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyachiev(
+    ACTION migrateranks(symbol badge_symbol, uint32_t limit);
+    ACTION backfillhist(name org, symbol badge_symbol, uint32_t limit);
+    ACTION initlifetime(name org, symbol badge_symbol);
+    ACTION settopk(name org, symbol badge_symbol, uint16_t k);
+
+    // Approximate balance percentiles of the badge's holders, as the bounds of the histogram
+    // bucket each falls in.
+    [[eosio::action, eosio::read_only]] vector<percentile_view> percentiles(name org, symbol badge_symbol, vector<uint8_t> percentiles);
+
+    // Opts the badge in to a rolling window with the given bucket size and count, clearing what
+    // it held, or out with a bucket_count of 0.
+    ACTION setwindow(name org, symbol badge_symbol, uint32_t bucket_sec, uint16_t bucket_count);
+
+    struct window_view {
+        uint64_t issued;
+        uint64_t issuances;
+        uint64_t window_sec; // the span actually summed, whole buckets capped at the window's length
+    };
+
+    // Issuance over the last window_sec, counted in whole buckets including the current one.
+    // All zero for badges without a rolling window.
+    [[eosio::action, eosio::read_only]] window_view windowstats(name org, symbol badge_symbol, uint32_t window_sec);
+
+    [[eosio::on_notify(NEW_BADGE_ISSUANCE_NOTIFICATION)]] void notifyissue(
+    uint8_t version,
     name org,
     asset badge_asset, 
     name from, 
     name to, 
-    string memo, 
-    vector<name> notify_accounts);
+    uint64_t issuance_seq, 
+    std::optional<uint64_t> balance);
+
+    [[eosio::on_notify(BATCH_ISSUANCE_NOTIFICATION)]] void notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo);
 
   private:
     // scoped by org
@@ -41,7 +80,8 @@ CONTRACT statistics : public contract {
     };
     typedef multi_index<"counts"_n, counts> counts_table;
 
-    // scoped by badge_symbol
+    // scoped by badge_symbol. Superseded by rankings; rows are drained by migrateranks, and an
+    // account found in rankings takes precedence over any entry left here.
     TABLE ranks {
         vector<name> accounts;
         uint64_t balance;
@@ -49,41 +89,182 @@ CONTRACT statistics : public contract {
     };
     typedef multi_index<"ranks"_n, ranks> ranks_table;
 
+    // scoped by badge_symbol. One row per account, ordered by (balance, account) through bybalance.
+    TABLE rankings {
+        name account;
+        uint64_t balance;
+        uint64_t primary_key() const { return account.value; }
+        uint128_t by_balance() const { return (static_cast<uint128_t>(balance) << 64) | account.value; }
+    };
+    typedef multi_index<"rankings"_n, rankings,
+        indexed_by<"bybalance"_n, const_mem_fun<rankings, uint128_t, &rankings::by_balance>>
+    > rankings_table;
 
-    void update_rank(name org, name account, symbol badge_symbol, uint64_t old_balance, uint64_t new_balance) {
+    // scoped by org. Badges in top-K mode keep only their k highest balances here, highest
+    // first, and no longer write rankings.
+    TABLE leaderboard {
+        symbol badge_symbol;
+        uint16_t k;
+        vector<leader> leaders;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef multi_index<"leaderboard"_n, leaderboard> leaderboard_table;
 
-        ranks_table _ranks(get_self(), badge_symbol.code().raw()); // Use badge_agg_seq_id as scope
-        // Check and remove the player's name from the old score, if provided and different
+    void update_leaderboard(leaderboard_table& _leaderboard, leaderboard_table::const_iterator itr, name account, uint64_t balance) {
+        vector<leader> leaders = itr->leaders;
+        if (!place_leader(leaders, itr->k, account, balance)) {
+            return;
+        }
+        _leaderboard.modify(itr, get_self(), [&](auto& entry) {
+            entry.leaders = leaders;
+        });
+    }
 
-        if (old_balance != new_balance) {
-            auto old_itr = _ranks.find(old_balance);
-            if (old_itr != _ranks.end()) {
-                auto old_names = old_itr->accounts;
-                old_names.erase(std::remove(old_names.begin(), old_names.end(), account), old_names.end());
-                if (old_names.empty()) {
-                    _ranks.erase(old_itr); // Remove the score entry if no names are left
-                } else {
-                    _ranks.modify(old_itr, get_self(), [&](auto& entry) {
-                        entry.accounts = old_names;
-                    });
-                }
-            }
+    void update_rank(name org, name account, symbol badge_symbol, uint64_t new_balance) {
+        leaderboard_table _leaderboard(get_self(), org.value);
+        auto board_itr = _leaderboard.find(badge_symbol.code().raw());
+        if (board_itr != _leaderboard.end()) {
+            update_leaderboard(_leaderboard, board_itr, account, new_balance);
+            return;
         }
-        auto new_itr = _ranks.find(new_balance);
-        if (new_itr == _ranks.end()) {
-            _ranks.emplace(get_self(), [&](auto& entry) {
+
+        rankings_table _rankings(get_self(), badge_symbol.code().raw());
+        auto itr = _rankings.find(account.value);
+        if (itr == _rankings.end()) {
+            _rankings.emplace(get_self(), [&](auto& entry) {
+                entry.account = account;
                 entry.balance = new_balance;
-                entry.accounts.push_back(account);
             });
-        } else {
-            if (std::find(new_itr->accounts.begin(), new_itr->accounts.end(), account) == new_itr->accounts.end()) {
-                _ranks.modify(new_itr, get_self(), [&](auto& entry) {
-                    entry.accounts.push_back(account);
-                });
-            } // If player name already exists for this score, no action needed
+        } else if (itr->balance != new_balance) {
+            _rankings.modify(itr, get_self(), [&](auto& entry) {
+                entry.balance = new_balance;
+            });
+        }
+    }
+
+    // scoped by org. Holder count per log-scale balance bucket. Until backfilled, only accounts
+    // listed in histcounted are in the buckets; backfillhist walks rankings from next_account
+    // to add the rest.
+    TABLE histogram {
+        symbol badge_symbol;
+        vector<uint64_t> buckets;
+        name next_account;
+        bool backfilled;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef multi_index<"histogram"_n, histogram> histogram_table;
+
+    // scoped by badge_symbol. Accounts already in the histogram while it is not backfilled.
+    // Emptied by backfillhist once it is.
+    TABLE histcounted {
+        name account;
+        uint64_t primary_key() const { return account.value; }
+    };
+    typedef multi_index<"histcounted"_n, histcounted> histcounted_table;
+
+    // Marks the account as counted, returning whether it already was.
+    bool mark_counted(symbol badge_symbol, name account) {
+        histcounted_table _histcounted(get_self(), badge_symbol.code().raw());
+        if (_histcounted.find(account.value) != _histcounted.end()) {
+            return true;
         }
-            
+        _histcounted.emplace(get_self(), [&](auto& entry) {
+            entry.account = account;
+        });
+        return false;
+    }
 
+    // Whether anyone but the account may hold the badge from before its histogram existed.
+    // Badges in top-K mode no longer list new holders in rankings, so they always may.
+    bool has_earlier_holders(name org, symbol badge_symbol, name account) {
+        rankings_table _rankings(get_self(), badge_symbol.code().raw());
+        auto itr = _rankings.begin();
+        if (itr != _rankings.end() && itr->account == account) {
+            itr++;
+        }
+        ranks_table _ranks(get_self(), badge_symbol.code().raw());
+        leaderboard_table _leaderboard(get_self(), org.value);
+        return itr != _rankings.end() || _ranks.begin() != _ranks.end() ||
+            _leaderboard.find(badge_symbol.code().raw()) != _leaderboard.end();
+    }
+
+    // An account is moved out of its old bucket only once it is known to be counted; otherwise
+    // it is just added and, until the histogram is backfilled, marked as counted.
+    void update_histogram(name org, name account, symbol badge_symbol, uint64_t old_balance, uint64_t new_balance) {
+        histogram_table _histogram(get_self(), org.value);
+        auto itr = _histogram.find(badge_symbol.code().raw());
+        if (itr == _histogram.end()) {
+            vector<uint64_t> buckets;
+            move_in_histogram(buckets, 0, new_balance);
+            bool backfilled = !has_earlier_holders(org, badge_symbol, account);
+            if (!backfilled) {
+                mark_counted(badge_symbol, account);
+            }
+            _histogram.emplace(get_self(), [&](auto& entry) {
+                entry.badge_symbol = badge_symbol;
+                entry.buckets = buckets;
+                entry.next_account = name();
+                entry.backfilled = backfilled;
+            });
+            return;
+        }
+        bool counted = itr->backfilled || mark_counted(badge_symbol, account);
+        vector<uint64_t> buckets = itr->buckets;
+        if (!move_in_histogram(buckets, counted ? old_balance : 0, new_balance)) {
+            return;
+        }
+        _histogram.modify(itr, get_self(), [&](auto& entry) {
+            entry.buckets = buckets;
+        });
+    }
+
+    // scoped by org. Ring buffer of issuance per time bucket; slot (bucket % size) holds
+    // absolute bucket `bucket` for the last issued.size() buckets up to head_bucket. Only
+    // badges that opted in through setwindow have a row.
+    TABLE rolling {
+        symbol badge_symbol;
+        uint32_t bucket_sec;
+        uint64_t head_bucket;
+        vector<uint64_t> issued;
+        vector<uint64_t> issuances;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef multi_index<"rolling"_n, rolling> rolling_table;
+
+    static uint64_t current_bucket(uint32_t bucket_sec) {
+        return current_time_point().sec_since_epoch() / bucket_sec;
+    }
+
+    // Moves the head to the current bucket, clearing the slots skipped since the last issuance.
+    static void advance_window(rolling& window, uint64_t bucket) {
+        if (bucket <= window.head_bucket) {
+            return;
+        }
+        uint64_t size = window.issued.size();
+        uint64_t steps = std::min<uint64_t>(bucket - window.head_bucket, size);
+        for (uint64_t i = 1; i <= steps; i++) {
+            uint64_t slot = (window.head_bucket + i) % size;
+            window.issued[slot] = 0;
+            window.issuances[slot] = 0;
+        }
+        window.head_bucket = bucket;
+    }
+
+    // Called once per notification, so a batch costs one write.
+    void update_rolling(name org, symbol badge_symbol, uint64_t issued, uint64_t issuances) {
+        rolling_table _rolling(get_self(), org.value);
+        auto itr = _rolling.find(badge_symbol.code().raw());
+        if (itr == _rolling.end()) {
+            return;
+        }
+        rolling window = *itr;
+        advance_window(window, current_bucket(window.bucket_sec));
+        uint64_t slot = window.head_bucket % window.issued.size();
+        window.issued[slot] += issued;
+        window.issuances[slot] += issuances;
+        _rolling.modify(itr, get_self(), [&](auto& entry) {
+            entry = window;
+        });
     }
 
     void update_count(name org, name account, symbol badge_symbol, uint64_t old_balance, uint64_t new_balance) {
@@ -112,9 +293,58 @@ CONTRACT statistics : public contract {
         }
     }
 
-    struct billing_args {
-      name org;
-      uint8_t actions_used;
+    // scoped by org. Badges whose lifetime balances statistics keeps itself, in place of
+    // cumulative, so an issuance needs neither cumulative's notification nor its table.
+    TABLE lifetime {
+        symbol badge_symbol;
+        uint64_t primary_key() const { return badge_symbol.code().raw(); }
+    };
+    typedef multi_index<"lifetime"_n, lifetime> lifetime_table;
+
+    // scoped by account. Same layout as cumulative's accounts, for badges in lifetime; these
+    // balances are kept only here, cumulative holds none for such badges.
+    TABLE lifetimebal {
+        asset balance;
+        uint64_t primary_key() const { return balance.symbol.code().raw(); }
     };
+    typedef multi_index<"lifetimebal"_n, lifetimebal> lifetimebal_table;
+
+    bool owns_balances(name org, const symbol& badge_symbol) {
+        lifetime_table _lifetime(get_self(), org.value);
+        return _lifetime.find(badge_symbol.code().raw()) != _lifetime.end();
+    }
+
+    uint64_t credit(name to, const asset& badge_asset) {
+        lifetimebal_table _balances(get_self(), to.value);
+        auto itr = _balances.find(badge_asset.symbol.code().raw());
+        if (itr == _balances.end()) {
+            _balances.emplace(get_self(), [&](auto& entry) {
+                entry.balance = badge_asset;
+            });
+            return badge_asset.amount;
+        }
+        _balances.modify(itr, get_self(), [&](auto& entry) {
+            entry.balance += badge_asset;
+        });
+        return itr->balance.amount;
+    }
+
+    // Badges in lifetime are credited here. Otherwise, without a balance from the notification,
+    // relies on cumulative having credited the balance earlier in the same notification.
+    void record_issuance(name org, name to, const asset& badge_asset, std::optional<uint64_t> balance, bool owns_balance) {
+        uint64_t new_balance;
+        if (owns_balance) {
+            new_balance = credit(to, badge_asset);
+        } else if (balance.has_value()) {
+            new_balance = *balance;
+        } else {
+            accounts _accounts(name(CUMULATIVE_CONTRACT), to.value);
+            auto accounts_itr = _accounts.find(badge_asset.symbol.code().raw());
+            new_balance = (accounts_itr == _accounts.end()) ? 0 : accounts_itr->balance.amount;
+        }
+        update_rank(org, to, badge_asset.symbol, new_balance);
+        update_count(org, to, badge_asset.symbol, new_balance - badge_asset.amount, new_balance);
+        update_histogram(org, to, badge_asset.symbol, new_balance - badge_asset.amount, new_balance);
+    }
 
 };
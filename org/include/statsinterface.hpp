@@ -0,0 +1,118 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <string>
+
+using namespace eosio;
+using namespace std;
+
+// Leaderboard and histogram logic shared by statistics and boundedstats. Each keeps its own
+// tables; only the row contents are worked out here.
+namespace stats_contract {
+    struct leader {
+        name account;
+        uint64_t balance;
+    };
+
+    // Puts the account on a board of at most k leaders, highest first. Issuances only grow
+    // balances, so a full board rejects any balance not above its last entry without looking
+    // for the account. Returns false when the board is left unchanged.
+    bool place_leader(vector<leader>& leaders, uint16_t k, name account, uint64_t balance) {
+        if (leaders.size() >= k && balance <= leaders[k - 1].balance) {
+            return false;
+        }
+        if (leaders.size() > k) {
+            leaders.resize(k); // k was lowered since the last update
+        }
+        auto pos = std::find_if(leaders.begin(), leaders.end(), [&](const auto& l) { return l.account == account; });
+        if (pos != leaders.end()) {
+            leaders.erase(pos);
+        } else if (leaders.size() >= k) {
+            leaders.pop_back();
+        }
+        // Ties keep the account that got there first ahead.
+        auto at = std::upper_bound(leaders.begin(), leaders.end(), balance, [](uint64_t b, const auto& l) { return b > l.balance; });
+        leaders.insert(at, leader { .account = account, .balance = balance });
+        return true;
+    }
+
+    struct percentile_view {
+        uint8_t percentile;
+        uint64_t lower;
+        uint64_t upper;
+    };
+
+    // Balances 0-3 get a bucket each, above that every power of two is split into
+    // HISTOGRAM_SUB_BUCKETS, so a bucket's bounds are within 25% of each other.
+    const uint8_t HISTOGRAM_SUB_BUCKETS = 4;
+
+    uint32_t histogram_bucket(uint64_t balance) {
+        if (balance < HISTOGRAM_SUB_BUCKETS) {
+            return balance;
+        }
+        uint32_t exponent = 63 - __builtin_clzll(balance);
+        uint32_t mantissa = (balance >> (exponent - 2)) & (HISTOGRAM_SUB_BUCKETS - 1);
+        return HISTOGRAM_SUB_BUCKETS + (exponent - 2) * HISTOGRAM_SUB_BUCKETS + mantissa;
+    }
+
+    pair<uint64_t, uint64_t> histogram_bounds(uint32_t bucket) {
+        if (bucket < HISTOGRAM_SUB_BUCKETS) {
+            return { bucket, bucket };
+        }
+        uint32_t exponent = (bucket - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS + 2;
+        uint64_t mantissa = HISTOGRAM_SUB_BUCKETS + (bucket - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+        uint64_t lower = mantissa << (exponent - 2);
+        uint64_t width = 1ULL << (exponent - 2);
+        return { lower, lower + (width - 1) };
+    }
+
+    // Moves an account from the bucket of its old balance to that of the new one; nothing is
+    // written while it stays in the same bucket. An account the histogram has not counted yet
+    // is passed with an old balance of 0, so it is only added and no other holder's bucket
+    // loses a count.
+    bool move_in_histogram(vector<uint64_t>& buckets, uint64_t old_balance, uint64_t new_balance) {
+        uint32_t old_bucket = histogram_bucket(old_balance);
+        uint32_t new_bucket = histogram_bucket(new_balance);
+        if (old_balance != 0 && new_balance != 0 && old_bucket == new_bucket) {
+            return false;
+        }
+        if (old_balance != 0) {
+            buckets[old_bucket]--;
+        }
+        if (new_balance != 0) {
+            if (new_bucket >= buckets.size()) {
+                buckets.resize(new_bucket + 1);
+            }
+            buckets[new_bucket]++;
+        }
+        return true;
+    }
+
+    // Bounds of the bucket holding each requested percentile (0-100) of the holders.
+    vector<percentile_view> histogram_percentiles(const vector<uint64_t>& buckets, const vector<uint8_t>& percentiles) {
+        uint64_t total = 0;
+        for (const auto& count : buckets) {
+            total += count;
+        }
+        vector<percentile_view> views;
+        for (const auto& percentile : percentiles) {
+            check(percentile <= 100, "percentile must be between 0 and 100");
+            percentile_view view { .percentile = percentile, .lower = 0, .upper = 0 };
+            if (total > 0) {
+                uint64_t rank = std::max<uint64_t>(1, (total * percentile + 99) / 100);
+                uint64_t seen = 0;
+                for (uint32_t bucket = 0; bucket < buckets.size(); bucket++) {
+                    seen += buckets[bucket];
+                    if (seen >= rank) {
+                        auto bounds = histogram_bounds(bucket);
+                        view.lower = bounds.first;
+                        view.upper = bounds.second;
+                        break;
+                    }
+                }
+            }
+            views.push_back(view);
+        }
+        return views;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+
+using namespace eosio;
+using namespace std;
+
+#define SUBSCRIPTION_CONTRACT "subscribedev"
+
+namespace subscription_contract {
+    struct billing_args {
+        name org;
+        uint8_t actions_used;
+    };
+
+    // billing takes a uint8_t, so large counts are sent in chunks. Nothing is sent for zero.
+    void bill(name self_contract, name org, uint64_t actions_used) {
+        while (actions_used > 0) {
+            uint8_t chunk = actions_used > UINT8_MAX ? UINT8_MAX : actions_used;
+            action {
+                permission_level{self_contract, name("active")},
+                name(SUBSCRIPTION_CONTRACT),
+                name("billing"),
+                billing_args {
+                    .org = org,
+                    .actions_used = chunk}
+            }.send();
+            actions_used -= chunk;
+        }
+    }
+}
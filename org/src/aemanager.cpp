@@ -50,19 +50,20 @@ ACTION aemanager::newemission(name authorized,
     }
   }.send();
 
+  vector<pair<symbol, name>> features;
   for (auto i = 0; i < emitter_criteria.size(); i++) {
-    action{
-      permission_level{get_self(), name("active")},
-      name(BADGEDATA_CONTRACT),
-      name("addfeature"),
-      addfeature_args{
-        .org = org,
-        .badge_symbol = emitter_criteria[i].symbol,
-        .notify_account = name(ANDEMITTER_CONTRACT),
-        .memo = ""
-      }
-    }.send();
+    features.push_back({emitter_criteria[i].symbol, name(ANDEMITTER_CONTRACT)});
   }
+  action {
+    permission_level{get_self(), name("active")},
+    name(BADGEDATA_CONTRACT),
+    name("addfeatures"),
+    addfeatures_args {
+      .org = org,
+      .features = features,
+      .memo = ""
+    }
+  }.send();
 }
 
 ACTION aemanager::activate(name authorized, symbol emission_symbol) {
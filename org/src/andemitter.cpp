@@ -1,9 +1,7 @@
 #include <andemitter.hpp>
-#include <json.hpp>
-using json = nlohmann::json;
 
-void andemitter::notifyachiev(name org, asset amount, name from, name to, string memo, vector<name> notify_accounts) {
-    string action_name = "notifyachiev";
+void andemitter::notifyissue(uint8_t version, name org, asset amount, name from, name to, uint64_t issuance_seq, std::optional<uint64_t> balance) {
+    string action_name = "notifyissue";
     string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
     
     activelookup_table active_lookup(get_self(), get_self().value);
@@ -12,51 +10,27 @@ void andemitter::notifyachiev(name org, asset amount, name from, name to, string
         return;
     }
 
-    emissions_table emissions(get_self(), org.value);
-    accounts_table accounts(get_self(), to.value);
+    uint8_t actions_used = process_achievement(org, amount, to, lookup_itr->active_emissions, failure_identifier);
 
-    uint8_t actions_used = 0;
-    for (const auto& emission_symbol : lookup_itr->active_emissions) {
-        auto emission_itr = emissions.find(emission_symbol.code().raw());
-        check(emission_itr != emissions.end(), "Emission does not exist");
+    bill(get_self(), org, actions_used);
 
-        auto account_itr = accounts.find(emission_symbol.code().raw());
-        uint8_t emission_status = emission_itr->cyclic ? CYCLIC_IN_PROGRESS : NON_CYCLIC_IN_PROGRESS;
+}
 
-        if (account_itr != accounts.end() && account_itr->emission_status == NON_CYCLIC_EMITTED) continue;
+void andemitter::notifybatch(name org, symbol badge_symbol, name from, vector<pair<name, int64_t>> recipients, string memo) {
+    string action_name = "notifybatch";
+    string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
 
-        if (account_itr == accounts.end()) {
-            account_itr = accounts.emplace(get_self(), [&](auto& acc) {
-                acc.emission_symbol = emission_symbol;
-                acc.emission_status = emission_status;
-            });
-        } else {
-            // Modification logic commented out
-            // accounts.modify(account_itr, same_payer, [&](auto& acc) {
-            //     acc.expanded_emitter_status[amount.symbol.code()] += amount.amount;
-            // });
-        }
-        auto expanded_emitter_status_map = account_itr->expanded_emitter_status;
-        update_expanded_emitter_status(to, expanded_emitter_status_map, amount, *emission_itr, emission_status, failure_identifier);
-
-        accounts.modify(account_itr, get_self(), [&](auto& acc) {
-            acc.expanded_emitter_status = expanded_emitter_status_map;
-            acc.emission_status = emission_status;
-        });
-        actions_used++;
+    activelookup_table active_lookup(get_self(), get_self().value);
+    auto lookup_itr = active_lookup.find(badge_symbol.code().raw());
+    if(lookup_itr == active_lookup.end()) {
+        return;
     }
 
-    if (actions_used > 0) {
-        action {
-            permission_level{get_self(), name("active")},
-            name(SUBSCRIPTION_CONTRACT),
-            name("billing"),
-            billing_args {
-                .org = org,
-                .actions_used = actions_used}
-        }.send();
+    uint64_t actions_used = 0;
+    for (const auto& recipient : recipients) {
+        actions_used += process_achievement(org, asset(recipient.second, badge_symbol), recipient.first, lookup_itr->active_emissions, failure_identifier);
     }
-
+    bill(get_self(), org, actions_used);
 }
 
 ACTION andemitter::newemission( name org,
@@ -106,14 +80,7 @@ ACTION andemitter::newemission( name org,
         em.cyclic                 = cyclic;
     });
 
-    action {
-        permission_level{get_self(), name("active")},
-        name(SUBSCRIPTION_CONTRACT),
-        name("billing"),
-        billing_args {
-            .org = org,
-            .actions_used = 1}
-    }.send();
+    bill(get_self(), org, 1);
 }
 
 ACTION andemitter::activate(name org, symbol emission_symbol) {
@@ -188,76 +155,51 @@ ACTION andemitter::offckeyvalue(name org, symbol emission_symbol, string key, st
     string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
 
-    // Open the emissions table.
-    emissions_table emissions(get_self(), org.value);
-    auto itr = emissions.find(emission_symbol.code().raw());
-    check(itr != emissions.end(), "Emission does not exist");
-
-    // Parse the current offchain_lookup_data.
-    nlohmann::json j;
-    if (itr->offchain_lookup_data.empty()) {
-        j = nlohmann::json::object();
-    } else if (nlohmann::json::accept(itr->offchain_lookup_data)) {
-        j = nlohmann::json::parse(itr->offchain_lookup_data);
-    } else {
-        check(false, "Stored offchain_lookup_data is not valid JSON");
-    }
-    check(j.is_object(), "offchain_lookup_data must be a JSON object");
+    patch_offchain_lookup(org, emission_symbol, { kvop { .key = key, .value = value } }, failure_identifier);
+}
 
-    // Ensure the "user" object exists.
-    if (j.find("user") == j.end() || !j["user"].is_object()) {
-        j["user"] = nlohmann::json::object();
-    }
+ACTION andemitter::onckeyvalue(name org, symbol emission_symbol, string key, string value) {
+    string action_name = "onckeyvalue";
+    string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
 
-    // Restrictions:
-    // 1. "system" tag cannot be modified.
-    check(key != "system", "Cannot modify system tag in offchain lookup");
+    patch_onchain_lookup(org, emission_symbol, { kvop { .key = key, .value = value } }, failure_identifier);
+}
 
-    // Update or insert the key/value pair under the "user" tag.
-    j["user"][key] = value;
+ACTION andemitter::offckvpatch(name org, symbol emission_symbol, vector<kvop> ops) {
+    string action_name = "offckvpatch";
+    string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
 
-    // Save the updated JSON back to the badge record.
-    emissions.modify(itr, get_self(), [&](auto& row) {
-        row.offchain_lookup_data = j.dump();
-    });
+    patch_offchain_lookup(org, emission_symbol, ops, failure_identifier);
 }
 
-ACTION andemitter::onckeyvalue(name org, symbol emission_symbol, string key, string value) {
-    string action_name = "onckeyvalue";
+ACTION andemitter::onckvpatch(name org, symbol emission_symbol, vector<kvop> ops) {
+    string action_name = "onckvpatch";
     string failure_identifier = "CONTRACT: andemitter, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
+
+    patch_onchain_lookup(org, emission_symbol, ops, failure_identifier);
+}
 
-    // Open the badge table.
+andemitter::emission_view andemitter::getemission(name org, symbol emission_symbol) {
     emissions_table emissions(get_self(), org.value);
     auto itr = emissions.find(emission_symbol.code().raw());
     check(itr != emissions.end(), "Emission does not exist");
 
-    // Parse the current onchain_lookup_data.
-    nlohmann::json j;
-    if (itr->onchain_lookup_data.empty()) {
-        j = nlohmann::json::object();
-    } else if (nlohmann::json::accept(itr->onchain_lookup_data)) {
-        j = nlohmann::json::parse(itr->onchain_lookup_data);
-    } else {
-        check(false, "Stored onchain_lookup_data is not valid JSON");
-    }
-    check(j.is_object(), "onchain_lookup_data must be a JSON object");
-
-    // Ensure the "user" object exists.
-    if (j.find("user") == j.end() || !j["user"].is_object()) {
-        j["user"] = nlohmann::json::object();
+    vector<asset> emitter_criteria;
+    for (const auto& [code, crit_asset] : itr->emitter_criteria) {
+        emitter_criteria.push_back(crit_asset);
     }
-
-    // Restrictions:
-    // 1. "system" tag cannot be modified.
-    check(key != "system", "Cannot modify system tag in onchain lookup");
-    // Update or insert the key/value pair under the "user" tag.
-    j["user"][key] = value;
-
-    // Save the updated JSON back to the badge record.
-    emissions.modify(itr, get_self(), [&](auto& row) {
-        row.onchain_lookup_data = j.dump();
-    });
-} 
-
-
+    return emission_view {
+        .emission_symbol = itr->emission_symbol,
+        .offchain_lookup = flatten_lookup(itr->offchain_lookup_data),
+        .onchain_lookup = flatten_lookup(itr->onchain_lookup_data),
+        .emitter_criteria = emitter_criteria,
+        .emit_assets = itr->emit_assets,
+        .status = itr->status,
+        .cyclic = itr->cyclic
+    };
+}
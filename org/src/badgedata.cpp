@@ -1,6 +1,4 @@
 #include <badgedata.hpp>
-#include <json.hpp>
-using json = nlohmann::json;
 
 
 ACTION badgedata::initbadge(name org,
@@ -21,34 +19,39 @@ ACTION badgedata::initbadge(name org,
     auto badge_itr = badges.find(badge_symbol.code().raw());
     check(badge_itr == badges.end(), "Badge already exists");
 
-    // Build the onchain JSON.
-    // Under "user": store display_name (as "name") and description (as "description").
-    // Under "system": store created_at timestamp.
-    nlohmann::json onchain_json;
-    onchain_json["user"] = {
-        {"display_name", display_name},
-        {"description", description}
-    };
-    uint32_t created_at = current_time_point().sec_since_epoch();
-    onchain_json["system"] = {
-        {"created_at", created_at}
-    };
-
-    // Build the offchain JSON.
-    // Under "user": store ipfs_image (as "ipfs_image").
-    nlohmann::json offchain_json;
-    offchain_json["user"] = {
-        {"ipfs_image", ipfs_image}
-    };
-
-    // Insert the new badge record.
+    // Insert the new badge record. Lookup data lives in the metadata table.
     badges.emplace(get_self(), [&](auto &row) {
         row.badge_symbol         = badge_symbol;
         row.notify_accounts      = vector<name>(); // Start with an empty list.
-        row.offchain_lookup_data = offchain_json.dump();
-        row.onchain_lookup_data  = onchain_json.dump();
+        row.offchain_lookup_data = "";
+        row.onchain_lookup_data  = "";
         row.rarity_counts        = 0;
     });
+
+    subscribers_table subscribers_t(get_self(), org.value);
+    subscribers_t.emplace(get_self(), [&](auto &row) {
+        row.badge_symbol = badge_symbol;
+        row.notify_mask  = 0;
+        row.notify_order = vector<uint8_t>();
+    });
+
+    rarity_table rarity_t(get_self(), org.value);
+    rarity_t.emplace(get_self(), [&](auto &row) {
+        row.badge_symbol  = badge_symbol;
+        row.rarity_counts = 0;
+    });
+
+    // Onchain: display_name and description under "user", created_at (a JSON number) under "system".
+    // Offchain: ipfs_image under "user".
+    uint32_t created_at = current_time_point().sec_since_epoch();
+    metadata_table metadata_t(get_self(), org.value);
+    metadata_t.emplace(get_self(), [&](auto &row) {
+        row.badge_symbol = badge_symbol;
+        put_lookup(row.onchain_lookup, USER_SECTION, "display_name", display_name);
+        put_lookup(row.onchain_lookup, USER_SECTION, "description", description);
+        put_lookup(row.onchain_lookup, SYSTEM_SECTION, "created_at", std::to_string(created_at), true);
+        put_lookup(row.offchain_lookup, USER_SECTION, "ipfs_image", ipfs_image);
+    });
 }
 
 ACTION badgedata::addfeature(
@@ -61,22 +64,21 @@ ACTION badgedata::addfeature(
     string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
 
+    // Migrate first: both rewrite the badge row through their own table handles.
+    ensure_migrated(org, badge_symbol);
+    subscribers subscribers_row = load_subscribers(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto metadata_itr = metadata_t.find(badge_symbol.code().raw());
+
     badge_table _badge(get_self(), org.value);
 
     auto badge_iterator = _badge.find(badge_symbol.code().raw());
     check(badge_iterator != _badge.end(), failure_identifier + " badge_symbol not initialized ");
 
-    vector<name> new_notify_accounts;
-    for (auto i = 0; i < badge_iterator->notify_accounts.size(); i++) {
-        if (notify_account == badge_iterator->notify_accounts[i]) {
-            return;
-        }
-        new_notify_accounts.push_back(badge_iterator->notify_accounts[i]);
+    if (!set_subscribed(subscribers_row, register_consumer(notify_account), true)) {
+        return;
     }
-    new_notify_accounts.push_back(notify_account);
-    _badge.modify(badge_iterator, get_self(), [&](auto& row) {
-        row.notify_accounts = new_notify_accounts;
-    });
+    store_subscribers(org, subscribers_row);
 
     action {
         permission_level{get_self(), name("active")},
@@ -87,9 +89,8 @@ ACTION badgedata::addfeature(
             .badge_symbol = badge_symbol,
             .notify_account = notify_account,
             .memo = memo,
-            .offchain_lookup_data = badge_iterator->offchain_lookup_data,
-            .onchain_lookup_data = badge_iterator->onchain_lookup_data,
-            .rarity_counts = badge_iterator->rarity_counts
+            .metadata_hash = metadata_hash(*metadata_itr),
+            .rarity_counts = rarity_counts(org, *badge_iterator)
         }
     }.send();
 }
@@ -99,8 +100,7 @@ ACTION badgedata::addnotify(
     symbol badge_symbol, 
     name notify_account, 
     string memo, 
-    string offchain_lookup_data, 
-    string onchain_lookup_data, 
+    checksum256 metadata_hash, 
     uint64_t rarity_counts) {
 
     require_auth(get_self());
@@ -117,20 +117,23 @@ ACTION badgedata::delfeature(
     string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
 
+    // Migrate first: both rewrite the badge row through their own table handles.
+    ensure_migrated(org, badge_symbol);
+    subscribers subscribers_row = load_subscribers(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto metadata_itr = metadata_t.find(badge_symbol.code().raw());
+
     badge_table _badge(get_self(), org.value);
 
     auto badge_iterator = _badge.find(badge_symbol.code().raw());
     check(badge_iterator != _badge.end(), failure_identifier + " badge_symbol not initialized ");
 
-    vector<name> new_notify_accounts;
-    for (auto i = 0; i < badge_iterator->notify_accounts.size(); i++) {
-        if (notify_account != badge_iterator->notify_accounts[i]) {
-            new_notify_accounts.push_back(badge_iterator->notify_accounts[i]);
-        }
+    // Nothing to tell a consumer that was not subscribed.
+    std::optional<uint8_t> consumer_id = find_consumer(notify_account);
+    if (!consumer_id.has_value() || !set_subscribed(subscribers_row, *consumer_id, false)) {
+        return;
     }
-    _badge.modify(badge_iterator, get_self(), [&](auto& row) {
-        row.notify_accounts = new_notify_accounts;
-    });
+    store_subscribers(org, subscribers_row);
 
     action {
         permission_level{get_self(), name("active")},
@@ -141,9 +144,8 @@ ACTION badgedata::delfeature(
             .badge_symbol = badge_symbol,
             .notify_account = notify_account,
             .memo = memo,
-            .offchain_lookup_data = badge_iterator->offchain_lookup_data,
-            .onchain_lookup_data = badge_iterator->onchain_lookup_data,
-            .rarity_counts = badge_iterator->rarity_counts
+            .metadata_hash = metadata_hash(*metadata_itr),
+            .rarity_counts = rarity_counts(org, *badge_iterator)
         }
     }.send();
 }
@@ -153,14 +155,77 @@ ACTION badgedata::delnotify(
     symbol badge_symbol, 
     name notify_account, 
     string memo, 
-    string offchain_lookup_data, 
-    string onchain_lookup_data, 
+    checksum256 metadata_hash, 
     uint64_t rarity_counts) {
 
     require_auth(get_self());
     require_recipient(notify_account);
 
 }
+ACTION badgedata::addfeatures(
+    name org,
+    vector<pair<symbol, name>> features,
+    string memo) {
+
+    string action_name = "addfeatures";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    vector<featurechange> changes = apply_features(org, features, true);
+    if (changes.empty()) {
+        return;
+    }
+
+    action {
+        permission_level{get_self(), name("active")},
+        get_self(),
+        name("addnotifs"),
+        notifyfeatures_args {
+            .org = org,
+            .changes = changes,
+            .memo = memo
+        }
+    }.send();
+}
+
+ACTION badgedata::delfeatures(
+    name org,
+    vector<pair<symbol, name>> features,
+    string memo) {
+
+    string action_name = "delfeatures";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    vector<featurechange> changes = apply_features(org, features, false);
+    if (changes.empty()) {
+        return;
+    }
+
+    action {
+        permission_level{get_self(), name("active")},
+        get_self(),
+        name("delnotifs"),
+        notifyfeatures_args {
+            .org = org,
+            .changes = changes,
+            .memo = memo
+        }
+    }.send();
+}
+
+ACTION badgedata::addnotifs(name org, vector<featurechange> changes, string memo) {
+    require_auth(get_self());
+    for (const auto& change : changes) {
+        require_recipient(change.notify_account);
+    }
+}
+
+ACTION badgedata::delnotifs(name org, vector<featurechange> changes, string memo) {
+    require_auth(get_self());
+    for (const auto& change : changes) {
+        require_recipient(change.notify_account);
+    }
+}
+
 ACTION badgedata::achievement(
     name org,
     asset badge_asset, 
@@ -177,21 +242,27 @@ ACTION badgedata::achievement(
     auto badge_iterator = _badge.find(badge_asset.symbol.code().raw());
     check(badge_iterator != _badge.end(), failure_identifier + " symbol for asset not initialized ");
 
-    _badge.modify(badge_iterator, get_self(), [&](auto& row) {
-        row.rarity_counts += badge_asset.amount;
-    });
+    add_rarity(org, *badge_iterator, badge_asset.amount);
+
+    uint64_t issuance_seq = next_issuance_seq(org);
+    uint32_t capacity = event_log_capacity(org);
+    if (capacity > 0) {
+        log_event(org, capacity, issuance_seq, badge_asset.symbol, to, badge_asset.amount);
+        bill(get_self(), org, 1);
+    }
 
     action {
         permission_level{get_self(), name("active")},
         get_self(),
-        name("notifyachiev"),
-        notifyachievement_args {
+        name("notifyissue"),
+        notifyissue_args {
+            .version = NOTIFY_ISSUE_VERSION,
             .org = org,
             .badge_asset = badge_asset,
             .from = from,
             .to = to,
-            .memo = memo,
-            .notify_accounts = badge_iterator->notify_accounts
+            .issuance_seq = issuance_seq,
+            .balance = balance_after(org, to, badge_asset)
         }
     }.send();    
 }
@@ -211,43 +282,112 @@ ACTION badgedata::notifyachiev(
 
 }
 
-ACTION badgedata::offckeyvalue(name org, symbol badge_symbol, string key, string value) {
-    string action_name = "offckeyvalue";
+ACTION badgedata::notifyissue(
+    uint8_t version,
+    name org,
+    asset badge_asset,
+    name from,
+    name to,
+    uint64_t issuance_seq,
+    std::optional<uint64_t> balance) {
+
+    require_auth(get_self());
+    for (auto& notify_account : subscribed_accounts(org, badge_asset.symbol)) {
+        require_recipient(notify_account);
+    }
+}
+
+ACTION badgedata::achievements(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo) {
+
+    string action_name = "achievements";
     string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
+    if (recipients.empty()) {
+        return;
+    }
 
-    // Open the badge table.
-    badge_table badges(get_self(), org.value);
-    auto itr = badges.find(badge_symbol.code().raw());
-    check(itr != badges.end(), "Badge does not exist");
-
-    // Parse the current offchain_lookup_data.
-    nlohmann::json j;
-    if (itr->offchain_lookup_data.empty()) {
-        j = nlohmann::json::object();
-    } else if (nlohmann::json::accept(itr->offchain_lookup_data)) {
-        j = nlohmann::json::parse(itr->offchain_lookup_data);
-    } else {
-        check(false, "Stored offchain_lookup_data is not valid JSON");
+    badge_table _badge(get_self(), org.value);
+
+    auto badge_iterator = _badge.find(badge_symbol.code().raw());
+    check(badge_iterator != _badge.end(), failure_identifier + " symbol for asset not initialized ");
+
+    // Merge repeated recipients so consumers see one post-issuance balance per account.
+    std::sort(recipients.begin(), recipients.end());
+    vector<pair<name, int64_t>> merged_recipients;
+    int64_t total_amount = 0;
+    for (const auto& recipient : recipients) {
+        check(recipient.second > 0 && recipient.second <= asset::max_amount, failure_identifier + "amount out of range");
+        // Both sums stay within max_amount, so neither can overflow int64.
+        check(total_amount <= asset::max_amount - recipient.second, failure_identifier + "total amount exceeds max asset amount");
+        if (!merged_recipients.empty() && merged_recipients.back().first == recipient.first) {
+            merged_recipients.back().second += recipient.second;
+        } else {
+            merged_recipients.push_back(recipient);
+        }
+        total_amount += recipient.second;
     }
-    check(j.is_object(), "offchain_lookup_data must be a JSON object");
 
-    // Ensure the "user" object exists.
-    if (j.find("user") == j.end() || !j["user"].is_object()) {
-        j["user"] = nlohmann::json::object();
+    add_rarity(org, *badge_iterator, total_amount);
+
+    uint64_t issuance_seq = next_issuance_seq(org, merged_recipients.size());
+    uint32_t capacity = event_log_capacity(org);
+    if (capacity > 0) {
+        for (const auto& recipient : merged_recipients) {
+            log_event(org, capacity, issuance_seq++, badge_symbol, recipient.first, recipient.second);
+        }
+        bill(get_self(), org, merged_recipients.size());
     }
 
+    action {
+        permission_level{get_self(), name("active")},
+        get_self(),
+        name("notifybatch"),
+        notifybatch_args {
+            .org = org,
+            .badge_symbol = badge_symbol,
+            .from = from,
+            .recipients = merged_recipients,
+            .memo = memo
+        }
+    }.send();
+}
+
+ACTION badgedata::notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo) {
+
+    require_auth(get_self());
+    for (auto& notify_account : subscribed_accounts(org, badge_symbol)) {
+        require_recipient(notify_account);
+    }
+}
+
+ACTION badgedata::offckeyvalue(name org, symbol badge_symbol, string key, string value) {
+    string action_name = "offckeyvalue";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+
     // Restrictions:
     // 1. "system" tag cannot be modified.
     check(key != "system", "Cannot modify system tag in offchain lookup");
     // (Note: "name" and "description" tags are allowed offchain.)
 
-    // Update or insert the key/value pair under the "user" tag.
-    j["user"][key] = value;
+    ensure_migrated(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_symbol.code().raw());
+    check(itr != metadata_t.end(), "Badge metadata does not exist");
 
-    // Save the updated JSON back to the badge record.
-    badges.modify(itr, get_self(), [&](auto& row) {
-        row.offchain_lookup_data = j.dump();
+    // Update or insert the key/value pair under the "user" tag.
+    metadata_t.modify(itr, get_self(), [&](auto& row) {
+        put_lookup(row.offchain_lookup, USER_SECTION, key, value);
     });
 }
 
@@ -256,39 +396,195 @@ ACTION badgedata::onckeyvalue(name org, symbol badge_symbol, string key, string
     string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
     check_internal_auth(get_self(), name(action_name), failure_identifier);
 
-    // Open the badge table.
-    badge_table badges(get_self(), org.value);
-    auto itr = badges.find(badge_symbol.code().raw());
-    check(itr != badges.end(), "Badge does not exist");
-
-    // Parse the current onchain_lookup_data.
-    nlohmann::json j;
-    if (itr->onchain_lookup_data.empty()) {
-        j = nlohmann::json::object();
-    } else if (nlohmann::json::accept(itr->onchain_lookup_data)) {
-        j = nlohmann::json::parse(itr->onchain_lookup_data);
-    } else {
-        check(false, "Stored onchain_lookup_data is not valid JSON");
-    }
-    check(j.is_object(), "onchain_lookup_data must be a JSON object");
-
-    // Ensure the "user" object exists.
-    if (j.find("user") == j.end() || !j["user"].is_object()) {
-        j["user"] = nlohmann::json::object();
-    }
-
     // Restrictions:
     // 1. "system" tag cannot be modified.
     check(key != "system", "Cannot modify system tag in onchain lookup");
 
+    ensure_migrated(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_symbol.code().raw());
+    check(itr != metadata_t.end(), "Badge metadata does not exist");
 
     // Update or insert the key/value pair under the "user" tag.
-    j["user"][key] = value;
+    metadata_t.modify(itr, get_self(), [&](auto& row) {
+        put_lookup(row.onchain_lookup, USER_SECTION, key, value);
+    });
+}
+
+ACTION badgedata::offckvpatch(name org, symbol badge_symbol, vector<org_contract::kvop> ops) {
+    string action_name = "offckvpatch";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
+
+    ensure_migrated(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_symbol.code().raw());
+    check(itr != metadata_t.end(), "Badge metadata does not exist");
 
-    // Save the updated JSON back to the badge record.
-    badges.modify(itr, get_self(), [&](auto& row) {
-        row.onchain_lookup_data = j.dump();
+    metadata_t.modify(itr, get_self(), [&](auto& row) {
+        patch_lookup(row.offchain_lookup, ops, failure_identifier);
     });
-} 
+}
+
+ACTION badgedata::onckvpatch(name org, symbol badge_symbol, vector<org_contract::kvop> ops) {
+    string action_name = "onckvpatch";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
 
+    ensure_migrated(org, badge_symbol);
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_symbol.code().raw());
+    check(itr != metadata_t.end(), "Badge metadata does not exist");
 
+    metadata_t.modify(itr, get_self(), [&](auto& row) {
+        patch_lookup(row.onchain_lookup, ops, failure_identifier);
+    });
+}
+
+ACTION badgedata::migratemeta(name org, uint32_t limit) {
+    require_auth(get_self());
+
+    // Visits up to `limit` badges of the org from where the last call stopped, converting the
+    // legacy JSON rows among them; rerun until the org is marked done.
+    metamigration_singleton metamigration_s(get_self(), org.value);
+    metamigration state = metamigration_s.get_or_default(metamigration { .next_badge = 0, .done = false });
+    check(!state.done, "badge metadata already migrated for org");
+
+    badge_table badges(get_self(), org.value);
+    auto itr = badges.lower_bound(state.next_badge);
+    for (uint32_t visited = 0; itr != badges.end() && visited < limit; itr++, visited++) {
+        if (!itr->offchain_lookup_data.empty() || !itr->onchain_lookup_data.empty()) {
+            migrate_lookup(org, badges, itr);
+        }
+        state.next_badge = itr->badge_symbol.code().raw() + 1;
+    }
+    state.done = itr == badges.end();
+    metamigration_s.set(state, get_self());
+}
+
+ACTION badgedata::migratesubs(name org, uint32_t limit) {
+    require_auth(get_self());
+
+    // Visits up to `limit` badges of the org from where the last call stopped, moving the
+    // legacy notify_accounts lists among them into subscribers rows; rerun until done.
+    submigration_singleton submigration_s(get_self(), org.value);
+    metamigration state = submigration_s.get_or_default(metamigration { .next_badge = 0, .done = false });
+    check(!state.done, "badge subscribers already migrated for org");
+
+    badge_table badges(get_self(), org.value);
+    subscribers_table subscribers_t(get_self(), org.value);
+    auto itr = badges.lower_bound(state.next_badge);
+    for (uint32_t visited = 0; itr != badges.end() && visited < limit; itr++, visited++) {
+        if (subscribers_t.find(itr->badge_symbol.code().raw()) == subscribers_t.end()) {
+            migrate_subscribers(org, badges, itr);
+        }
+        state.next_badge = itr->badge_symbol.code().raw() + 1;
+    }
+    state.done = itr == badges.end();
+    submigration_s.set(state, get_self());
+}
+
+badgedata::lookup_json badgedata::lookupjson(name org, symbol badge_symbol) {
+    badge_table badges(get_self(), org.value);
+    auto badge_itr = badges.find(badge_symbol.code().raw());
+    check(badge_itr != badges.end(), "Badge does not exist");
+
+    // Rows not yet migrated still carry their JSON.
+    if (!badge_itr->offchain_lookup_data.empty() || !badge_itr->onchain_lookup_data.empty()) {
+        return lookup_json {
+            .offchain_lookup_data = badge_itr->offchain_lookup_data,
+            .onchain_lookup_data = badge_itr->onchain_lookup_data
+        };
+    }
+
+    metadata_table metadata_t(get_self(), org.value);
+    auto itr = metadata_t.find(badge_symbol.code().raw());
+    check(itr != metadata_t.end(), "Badge metadata does not exist");
+    return lookup_json {
+        .offchain_lookup_data = render_lookup(itr->offchain_lookup),
+        .onchain_lookup_data = render_lookup(itr->onchain_lookup)
+    };
+}
+
+
+badgedata::badge_view badgedata::getbadge(name org, symbol badge_symbol) {
+    badge_table badges(get_self(), org.value);
+    auto badge_itr = badges.find(badge_symbol.code().raw());
+    check(badge_itr != badges.end(), "Badge does not exist");
+    return make_badge_view(org, *badge_itr);
+}
+
+badgedata::badge_page badgedata::getbadges(name org, symbol_code lower, uint32_t limit) {
+    check(limit > 0 && limit <= MAX_PAGE_SIZE, "limit must be between 1 and " + std::to_string(MAX_PAGE_SIZE));
+
+    badge_table badges(get_self(), org.value);
+    badge_page page;
+    auto itr = badges.lower_bound(lower.raw());
+    for (; itr != badges.end() && page.badges.size() < limit; itr++) {
+        page.badges.push_back(make_badge_view(org, *itr));
+    }
+    if (itr != badges.end()) {
+        page.next = itr->badge_symbol.code();
+    }
+    return page;
+}
+
+badgedata::event_page badgedata::events(name org, uint64_t from_seq, uint32_t limit) {
+    check(limit > 0 && limit <= MAX_PAGE_SIZE, "limit must be between 1 and " + std::to_string(MAX_PAGE_SIZE));
+
+    uint64_t last_seq = last_issuance_seq(org);
+    eventlogcfg_singleton eventlogcfg_s(get_self(), org.value);
+    if (!eventlogcfg_s.exists()) {
+        return event_page { .oldest_seq = last_seq + 1, .next_seq = std::max(from_seq, last_seq + 1) };
+    }
+    eventlogcfg cfg = eventlogcfg_s.get();
+    uint64_t oldest_seq = last_seq >= cfg.capacity ? last_seq - cfg.capacity + 1 : 1;
+    oldest_seq = std::max(oldest_seq, cfg.first_seq);
+    uint64_t seq = std::max(from_seq, oldest_seq);
+
+    event_page page { .oldest_seq = oldest_seq };
+    eventlog_table eventlog_t(get_self(), org.value);
+    for (; seq <= last_seq && page.events.size() < limit; seq++) {
+        auto itr = eventlog_t.find(seq % cfg.capacity);
+        if (itr == eventlog_t.end() || itr->seq != seq) {
+            continue;
+        }
+        page.events.push_back(issuance_event {
+            .seq = itr->seq,
+            .badge_symbol = itr->badge_symbol,
+            .to = itr->to,
+            .amount = itr->amount,
+            .block_time = itr->block_time
+        });
+    }
+    page.next_seq = seq;
+    return page;
+}
+
+ACTION badgedata::seteventlog(name org, uint32_t capacity) {
+    string action_name = "seteventlog";
+    string failure_identifier = "CONTRACT: badgedata, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(capacity <= MAX_EVENT_LOG_CAPACITY, failure_identifier + "capacity above " + std::to_string(MAX_EVENT_LOG_CAPACITY));
+
+    // A new capacity moves every slot, so the log restarts from the next issuance. Slots
+    // the new capacity no longer uses are freed a batch at a time; trimevents frees the rest.
+    // Left-over slots are never read, as events only looks at slots below the capacity.
+    trim_event_log(org, capacity, EVENT_LOG_TRIM_BATCH);
+    eventlogcfg_singleton eventlogcfg_s(get_self(), org.value);
+    if (capacity == 0) {
+        eventlogcfg_s.remove();
+        return;
+    }
+    eventlogcfg_s.set(eventlogcfg { .capacity = capacity, .first_seq = last_issuance_seq(org) + 1 }, get_self());
+}
+
+ACTION badgedata::trimevents(name org, uint32_t limit) {
+    require_auth(get_self());
+
+    uint32_t capacity = event_log_capacity(org);
+    check(!event_log_trimmed(org, capacity), "no event log slots left to free for org");
+    trim_event_log(org, capacity, limit);
+}
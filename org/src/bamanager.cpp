@@ -12,38 +12,30 @@ ACTION bamanager::initagg(name authorized, symbol agg_symbol, vector<symbol> bad
         has_agg_authority(org, name(action_name), agg, authorized);
       check (has_authority, failure_identifier + "Unauthorized account to execute action");
     }  
+    vector<pair<symbol, name>> features;
     for(auto i = 0 ; i < badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_AGG_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
     }
 
     for(auto i = 0 ; i < stats_badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(stats_badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + stats_badge_symbols[i].code().to_string());
       auto it = std::find(badge_symbols.begin(), badge_symbols.end(), stats_badge_symbols[i]);
       check(it != badge_symbols.end(), failure_identifier + "all element in stats_badge_symbols should be present in badge_symbols");
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = stats_badge_symbols[i],
-          .notify_account = name(BOUNDED_STATS_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({stats_badge_symbols[i], name(BOUNDED_STATS_CONTRACT)});
     }
 
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
     action {
       permission_level{get_self(), name("active")},
       name(BOUNDED_AGG_CONTRACT),
@@ -83,21 +75,23 @@ ACTION bamanager::addinitbadge(name authorized, symbol agg_symbol, vector<symbol
       check (has_authority, failure_identifier + "Unauthorized account to execute action");
     } 
 
+    vector<pair<symbol, name>> features;
     for(auto i = 0 ; i < badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_AGG_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
     }
 
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
     action {
       permission_level{get_self(), name("active")},
       name(BOUNDED_AGG_CONTRACT),
@@ -123,21 +117,23 @@ ACTION bamanager::reminitbadge(name authorized, symbol agg_symbol, vector<symbol
       check (has_authority, failure_identifier + "Unauthorized account to execute action");
     } 
 
+    vector<pair<symbol, name>> features;
     for(auto i = 0 ; i < badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_AGG_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
     }
 
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
     action {
       permission_level{get_self(), name("active")},
       name(BOUNDED_AGG_CONTRACT),
@@ -162,33 +158,24 @@ ACTION bamanager::addstatbadge(name authorized, symbol agg_symbol, vector<symbol
       check (has_authority, failure_identifier + "Unauthorized account to execute action");
     } 
 
+    vector<pair<symbol, name>> features;
     for(auto i = 0 ; i < badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_AGG_CONTRACT),
-          .memo = ""
-        }
-      }.send();
-      
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_STATS_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
+      features.push_back({badge_symbols[i], name(BOUNDED_STATS_CONTRACT)});
     }
 
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
     action {
       permission_level{get_self(), name("active")},
       name(BOUNDED_STATS_CONTRACT),
@@ -443,21 +430,23 @@ ACTION bamanager::addbadge(name authorized, symbol agg_symbol, vector<uint64_t>
       check (has_authority, failure_identifier + "Unauthorized account to execute action");
     } 
 
+    vector<pair<symbol, name>> features;
     for(auto i = 0 ; i < badge_symbols.size(); i++) {
       check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
-      action {
-        permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args{
-          .org = org,
-          .badge_symbol = badge_symbols[i],
-          .notify_account = name(BOUNDED_AGG_CONTRACT),
-          .memo = ""
-        }
-      }.send();
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
     }
 
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
     action {
       permission_level{get_self(), name("active")},
       name(BOUNDED_AGG_CONTRACT),
@@ -471,6 +460,106 @@ ACTION bamanager::addbadge(name authorized, symbol agg_symbol, vector<uint64_t>
     }.send();
 }
 
+ACTION bamanager::schedseq(name authorized, symbol agg_symbol, vector<symbol> badge_symbols, time_point_sec start, uint32_t length_sec, uint32_t count) {
+    require_auth(authorized);
+
+    string action_name = "schedseq";
+    string failure_identifier = "CONTRACT: bamanager, ACTION: " + action_name + ", MESSAGE: ";
+    
+    name org = get_org_from_internal_symbol(agg_symbol, failure_identifier);
+    name agg = get_name_from_internal_symbol(agg_symbol, failure_identifier);
+    notify_checks_contract(org);
+    if(org != authorized) {
+      bool has_authority = has_action_authority(org, name(action_name), authorized) ||
+        has_agg_authority(org, name(action_name), agg, authorized);
+      check (has_authority, failure_identifier + "Unauthorized account to execute action");
+    } 
+
+    vector<pair<symbol, name>> features;
+    for(auto i = 0 ; i < badge_symbols.size(); i++) {
+      check(org == get_org_from_internal_symbol(badge_symbols[i], failure_identifier), failure_identifier + "Org mismatch for badge " + badge_symbols[i].code().to_string());
+      features.push_back({badge_symbols[i], name(BOUNDED_AGG_CONTRACT)});
+    }
+
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = ""
+      }
+    }.send();
+
+    action {
+      permission_level{get_self(), name("active")},
+      name(BOUNDED_AGG_CONTRACT),
+      name("schedseq"),
+      schedseq_args {
+        .org = org,
+        .agg_symbol = agg_symbol,
+        .badge_symbols = badge_symbols,
+        .start = start,
+        .length_sec = length_sec,
+        .count = count
+      }
+    }.send();
+}
+
+ACTION bamanager::endsched(name authorized, symbol agg_symbol) {
+    require_auth(authorized);
+
+    string action_name = "endsched";
+    string failure_identifier = "CONTRACT: bamanager, ACTION: " + action_name + ", MESSAGE: ";
+    
+    name org = get_org_from_internal_symbol(agg_symbol, failure_identifier);
+    name agg = get_name_from_internal_symbol(agg_symbol, failure_identifier);
+    notify_checks_contract(org);
+    if(org != authorized) {
+      bool has_authority = has_action_authority(org, name(action_name), authorized) ||
+        has_agg_authority(org, name(action_name), agg, authorized);
+      check (has_authority, failure_identifier + "Unauthorized account to execute action");
+    } 
+
+    action {
+      permission_level{get_self(), name("active")},
+      name(BOUNDED_AGG_CONTRACT),
+      name("endsched"),
+      endsched_args {
+        .org = org,
+        .agg_symbol = agg_symbol
+      }
+    }.send();
+}
+
+ACTION bamanager::settopk(name authorized, symbol agg_symbol, uint16_t k) {
+    require_auth(authorized);
+
+    string action_name = "settopk";
+    string failure_identifier = "CONTRACT: bamanager, ACTION: " + action_name + ", MESSAGE: ";
+    
+    name org = get_org_from_internal_symbol(agg_symbol, failure_identifier);
+    name agg = get_name_from_internal_symbol(agg_symbol, failure_identifier);
+    notify_checks_contract(org);
+    if(org != authorized) {
+      bool has_authority = has_action_authority(org, name(action_name), authorized) ||
+        has_agg_authority(org, name(action_name), agg, authorized);
+      check (has_authority, failure_identifier + "Unauthorized account to execute action");
+    } 
+
+    action {
+      permission_level{get_self(), name("active")},
+      name(BOUNDED_STATS_CONTRACT),
+      name("settopk"),
+      settopk_args {
+        .org = org,
+        .agg_symbol = agg_symbol,
+        .k = k
+      }
+    }.send();
+}
+
 ACTION bamanager::pauseall(name authorized, symbol agg_symbol, uint64_t seq_id) {
     require_auth(authorized);
 
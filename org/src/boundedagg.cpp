@@ -1,6 +1,4 @@
 #include <boundedagg.hpp>
-#include <json.hpp>
-using json = nlohmann::json;
 
 ACTION boundedagg::initagg(name org, symbol agg_symbol, vector<symbol> init_badge_symbols, string ipfs_image, string display_name, string description) {
     string action_name = "initagg";
@@ -38,14 +36,14 @@ ACTION boundedagg::initagg(name org, symbol agg_symbol, vector<symbol> init_badg
         check(false, "Agg already exists");
     }
 
-    action {
-        permission_level{get_self(), name("active")},
-        name(SUBSCRIPTION_CONTRACT),
-        name("billing"),
-        billing_args {
-            .org = org,
-            .actions_used = 1}
-    }.send();
+    // An org whose first rows are written with packed keys never needs migratekeys.
+    keymigration_singleton keymigration_s(get_self(), org.value);
+    badgestatus_table badgestatus_t(get_self(), org.value);
+    if (!keymigration_s.exists() && badgestatus_t.begin() == badgestatus_t.end()) {
+        keymigration_s.set(keymigration { .next_badge_agg_seq_id = 0, .done = true }, get_self());
+    }
+
+    bill(get_self(), org, 1);
 
 }
 
@@ -102,11 +100,15 @@ ACTION boundedagg::initseq(name org, symbol agg_symbol, string sequence_descript
 
     check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
 
+    seqsets sets = read_seq_sets(org, agg_symbol, failure_identifier);
+
     // Update the last_init_seq_id in aggdetail table
     aggdetail_t.modify(aggdetail_itr, _self, [&](auto& row) {
         row.last_init_seq_id += 1;
-        row.init_seq_ids.push_back(row.last_init_seq_id);
     });
+    insert_seq_id(sets.init_seq_ids, aggdetail_itr->last_init_seq_id);
+    vector<symbol> init_badge_symbols = aggdetail_itr->init_badge_symbols;
+    store_seq_sets(org, sets);
 
     // Insert new entry in the sequence table
     sequence_table sequence_t(get_self(), agg_symbol.code().raw()); // Scope to agg_symbol.code().raw()
@@ -117,7 +119,9 @@ ACTION boundedagg::initseq(name org, symbol agg_symbol, string sequence_descript
         row.init_time = time_point_sec(current_time_point());
         // The active_time and end_time are left uninitialized here and will be set later
     });
-    if(aggdetail_itr->init_badge_symbols.size() > 0) {
+    // No rows yet, so the pause bitmap starts out seeded and empty.
+    store_pause_bits(agg_symbol, aggdetail_itr->last_init_seq_id, vector<uint64_t>());
+    if(init_badge_symbols.size() > 0) {
         action {
             permission_level{get_self(), name("active")},
             name(get_self()),
@@ -125,7 +129,7 @@ ACTION boundedagg::initseq(name org, symbol agg_symbol, string sequence_descript
             addbadgeli_args {
                 .org = org,
                 .agg_symbol = agg_symbol,
-                .badge_symbols = aggdetail_itr->init_badge_symbols
+                .badge_symbols = init_badge_symbols
             }
         }.send(); 
     }
@@ -139,27 +143,13 @@ ACTION boundedagg::actseq(name org, symbol agg_symbol, vector<uint64_t> seq_ids)
         check_internal_auth(get_self(), name(action_name), failure_identifier);
     }
 
-    // Access the aggdetail table
-    aggdetail_table aggdetail_t(_self, org.value);
-    auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
-
-    check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
-
-    // Update the last_init_seq_id in aggdetail table
-    aggdetail_t.modify(aggdetail_itr, _self, [&](auto& row) {
-        vector<uint64_t> init_seq_ids = row.init_seq_ids;
-        vector<uint64_t> new_init_seq_ids;
-        vector<uint64_t> new_active_seq_ids = row.active_seq_ids;
-        for (uint64_t seq_id : init_seq_ids) {
-            if (std::find(seq_ids.begin(), seq_ids.end(), seq_id) == seq_ids.end()) {
-                new_init_seq_ids.push_back(seq_id);
-            } else {
-                new_active_seq_ids.push_back(seq_id);
-            }
+    seqsets sets = read_seq_sets(org, agg_symbol, failure_identifier);
+    for (const auto& seq_id : seq_ids) {
+        if (erase_seq_id(sets.init_seq_ids, seq_id)) {
+            insert_seq_id(sets.active_seq_ids, seq_id);
         }
-        row.init_seq_ids = new_init_seq_ids;
-        row.active_seq_ids = new_active_seq_ids;
-    });
+    }
+    store_seq_sets(org, sets);
     
     sequence_table sequence_t(get_self(), agg_symbol.code().raw());
     for (auto& seq_id : seq_ids) {
@@ -171,7 +161,7 @@ ACTION boundedagg::actseq(name org, symbol agg_symbol, vector<uint64_t> seq_ids)
             row.seq_status = "active"_n;
             row.active_time = time_point_sec(current_time_point());
         });
-        update_status_in_badgestatus(org, agg_symbol, seq_id, "active"_n, failure_identifier);
+        // badgestatus rows are not rewritten, readers resolve the sequence status from here.
     }
 
 
@@ -225,30 +215,13 @@ ACTION boundedagg::endseq(name org, symbol agg_symbol, vector<uint64_t> seq_ids)
         check_internal_auth(get_self(), name(action_name), failure_identifier);
     }
 
-    // Access the aggdetail table
-    aggdetail_table aggdetail_t(_self, org.value);
-    auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
-
-    check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
-
-
-    aggdetail_t.modify(aggdetail_itr, _self, [&](auto& row) {
-        vector<uint64_t> active_seq_ids = row.active_seq_ids;
-        vector<uint64_t> new_active_seq_ids;
-        vector<uint64_t> end_seq_ids = row.end_seq_ids;
-        
-
-
-        for (uint64_t seq_id : active_seq_ids) {
-            if (std::find(seq_ids.begin(), seq_ids.end(), seq_id) == seq_ids.end()) {
-                new_active_seq_ids.push_back(seq_id);
-            } else {
-                end_seq_ids.push_back(seq_id);
-            }
+    seqsets sets = read_seq_sets(org, agg_symbol, failure_identifier);
+    for (const auto& seq_id : seq_ids) {
+        if (erase_seq_id(sets.active_seq_ids, seq_id)) {
+            insert_seq_id(sets.end_seq_ids, seq_id);
         }
-        row.active_seq_ids = new_active_seq_ids;
-        row.end_seq_ids = end_seq_ids;
-    });
+    }
+    store_seq_sets(org, sets);
     
     sequence_table sequence_t(get_self(), agg_symbol.code().raw());
     for (auto& seq_id : seq_ids) {
@@ -260,8 +233,6 @@ ACTION boundedagg::endseq(name org, symbol agg_symbol, vector<uint64_t> seq_ids)
             row.seq_status = "end"_n;
             row.end_time = time_point_sec(current_time_point());
         });
-
-        update_status_in_badgestatus(org, agg_symbol, seq_id, "end"_n, failure_identifier);
     }
 
 }
@@ -313,27 +284,30 @@ ACTION boundedagg::addbadge(name org, symbol agg_symbol, vector<uint64_t> seq_id
         check_internal_auth(get_self(), name(action_name), failure_identifier);
     }
 
-    uint8_t actions_used = 0;
     sequence_table sequence_t(get_self(), agg_symbol.code().raw());
     for (const auto& seq_id : seq_ids) {
-        auto itr = sequence_t.find(seq_id);
-        check(itr != sequence_t.end(), failure_identifier + "Sequence ID does not exist.");
-        for (const auto& badge_symbol : badge_symbols) {
-            actions_used++;
-            insert_record_in_badgestatus(org, agg_symbol, seq_id, badge_symbol, itr->seq_status, failure_identifier);
-        }
-    }
-    if(actions_used > 0) {
-        action {
-            permission_level{get_self(), name("active")},
-            name(SUBSCRIPTION_CONTRACT),
-            name("billing"),
-            billing_args {
-                .org = org,
-                .actions_used = actions_used}
-        }.send();    
+        check(sequence_t.find(seq_id) != sequence_t.end(), failure_identifier + "Sequence ID does not exist.");
     }
 
+    // Large calls do the first chunk here and leave the rest to continue.
+    uint64_t total_steps = seq_ids.size() * badge_symbols.size();
+    uint64_t done_steps = std::min(total_steps, ADDBADGE_CHUNK);
+    uint64_t inserted = add_badge_steps(org, agg_symbol, seq_ids, badge_symbols, 0, done_steps);
+    if (done_steps < total_steps) {
+        jobs_table jobs_t(get_self(), get_self().value);
+        jobs_t.emplace(get_self(), [&](auto& row) {
+            row.job_id = jobs_t.available_primary_key();
+            row.org = org;
+            row.agg_symbol = agg_symbol;
+            row.kind = "addbadge"_n;
+            row.seq_ids = seq_ids;
+            row.badge_symbols = badge_symbols;
+            row.next_step = done_steps;
+            row.total_steps = total_steps;
+            row.created_time = time_point_sec(current_time_point());
+        });
+    }
+    bill(get_self(), org, inserted);
 }
 
 ACTION boundedagg::addbadgefa(name org, symbol agg_symbol, vector<symbol> badge_symbols) {
@@ -435,47 +409,28 @@ ACTION boundedagg::addbadgeai(name org, symbol agg_symbol, vector<symbol> badge_
 
 }
 
-void boundedagg::notifyachiev(name org, asset badge_asset, name from, name to, string memo, vector<name> notify_accounts) {
-    string action_name = "notifyachiev";
+void boundedagg::notifyissue(uint8_t version, name org, asset badge_asset, name from, name to, uint64_t issuance_seq, std::optional<uint64_t> balance) {
+    string action_name = "notifyissue";
     string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
 
-    badgestatus_table badgestatus(get_self(), org.value);
-    auto by_status_index = badgestatus.get_index<"bybadgestat"_n>();
+    vector<seqbadge> seq_badges = active_seq_badges(org, badge_asset.symbol);
+    for (const auto& seq_badge : seq_badges) {
+        add_achievement(to, seq_badge, badge_asset.amount);
+    }
+    uint8_t actions_used = seq_badges.size();
+    bill(get_self(), org, actions_used);
 
-    auto hashed_active_status = hash_active_status(badge_asset.symbol, "active"_n, "active"_n);
-    achievements_table achievements(get_self(), to.value);
+}
 
-    auto itr = by_status_index.find(hashed_active_status);
-    uint8_t actions_used = 0;
-    while(itr != by_status_index.end() && itr->badge_symbol == badge_asset.symbol && itr->badge_status == "active"_n && itr->seq_status == "active"_n) {
-        
-        auto ach_itr = achievements.find(itr->badge_agg_seq_id);
-        if(ach_itr != achievements.end()) {
-            achievements.modify(ach_itr, get_self(), [&](auto& ach) {
-                ach.count += badge_asset.amount;
-            });
-        } else {
-            achievements.emplace(get_self(), [&](auto& ach) {
-                ach.badge_agg_seq_id = itr->badge_agg_seq_id;
-                ach.count = badge_asset.amount;
-            });
+void boundedagg::notifybatch(name org, symbol badge_symbol, name from, vector<pair<name, int64_t>> recipients, string memo) {
+    // Resolve the active sequences once for the whole batch.
+    vector<seqbadge> seq_badges = active_seq_badges(org, badge_symbol);
+    for (const auto& recipient : recipients) {
+        for (const auto& seq_badge : seq_badges) {
+            add_achievement(recipient.first, seq_badge, recipient.second);
         }
-        
-        // Move to the next record
-        actions_used ++;
-        ++itr;
-    }
-    if(actions_used > 0) {
-        action {
-            permission_level{get_self(), name("active")},
-            name(SUBSCRIPTION_CONTRACT),
-            name("billing"),
-            billing_args {
-                .org = org,
-                .actions_used = actions_used}
-        }.send();
     }
-
+    bill(get_self(), org, seq_badges.size() * recipients.size());
 }
 
 
@@ -547,77 +502,453 @@ void boundedagg::notifyachiev(name org, asset badge_asset, name from, name to, s
         string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
         check_internal_auth(get_self(), name(action_name), failure_identifier);
 
-        // Open the aggdetail table.
-        aggdetail_table aggdetail_t(_self, org.value);
-        auto itr = aggdetail_t.find(agg_symbol.code().raw());
-        check(itr != aggdetail_t.end(), "Agg does not exist");
-
-        // Parse the current offchain_lookup_data.
-        nlohmann::json j;
-        if (itr->offchain_lookup_data.empty()) {
-            j = nlohmann::json::object();
-        } else if (nlohmann::json::accept(itr->offchain_lookup_data)) {
-            j = nlohmann::json::parse(itr->offchain_lookup_data);
-        } else {
-            check(false, "Stored offchain_lookup_data is not valid JSON");
+        patch_offchain_lookup(org, agg_symbol, { kvop { .key = key, .value = value } }, failure_identifier);
+    }
+
+    ACTION boundedagg::onckeyvalue(name org, symbol agg_symbol, string key, string value) {
+        string action_name = "onckeyvalue";
+        string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+        check_internal_auth(get_self(), name(action_name), failure_identifier);
+
+        patch_onchain_lookup(org, agg_symbol, { kvop { .key = key, .value = value } }, failure_identifier);
+    }
+
+ACTION boundedagg::offckvpatch(name org, symbol agg_symbol, vector<kvop> ops) {
+    string action_name = "offckvpatch";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
+
+    patch_offchain_lookup(org, agg_symbol, ops, failure_identifier);
+}
+
+ACTION boundedagg::onckvpatch(name org, symbol agg_symbol, vector<kvop> ops) {
+    string action_name = "onckvpatch";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(!ops.empty(), failure_identifier + "no key/value operations given");
+
+    patch_onchain_lookup(org, agg_symbol, ops, failure_identifier);
+}
+
+boundedagg::agg_view boundedagg::getagg(name org, symbol agg_symbol) {
+    aggdetail_table aggdetail_t(get_self(), org.value);
+    auto itr = aggdetail_t.find(agg_symbol.code().raw());
+    check(itr != aggdetail_t.end(), "agg does not exist");
+    seqsets sets = read_seq_sets(org, agg_symbol, "");
+    agg_view view {
+        .agg_symbol = itr->agg_symbol,
+        .offchain_lookup = flatten_lookup(itr->offchain_lookup_data),
+        .onchain_lookup = flatten_lookup(itr->onchain_lookup_data),
+        .last_init_seq_id = itr->last_init_seq_id,
+        .init_seq_ids = expand_seq_ids(sets.init_seq_ids),
+        .active_seq_ids = expand_seq_ids(sets.active_seq_ids),
+        .end_seq_ids = expand_seq_ids(sets.end_seq_ids),
+        .init_badge_symbols = itr->init_badge_symbols
+    };
+
+    // Scheduled windows have no sequence rows; they are listed under the state the clock puts them in.
+    schedule_table schedule_t(get_self(), agg_symbol.code().raw());
+    time_point_sec now = time_point_sec(current_time_point());
+    bool scheduled = false;
+    for (auto sched_itr = schedule_t.begin(); sched_itr != schedule_t.end(); sched_itr++) {
+        for (uint32_t window = 0; window < sched_itr->count; window++) {
+            name status = window_status(*sched_itr, window, now);
+            vector<uint64_t>& seq_ids = status == "init"_n ? view.init_seq_ids : status == "active"_n ? view.active_seq_ids : view.end_seq_ids;
+            seq_ids.push_back(sched_itr->first_seq_id + window);
         }
-        check(j.is_object(), "offchain_lookup_data must be a JSON object");
+        scheduled = true;
+    }
+    if (scheduled) {
+        std::sort(view.init_seq_ids.begin(), view.init_seq_ids.end());
+        std::sort(view.active_seq_ids.begin(), view.active_seq_ids.end());
+        std::sort(view.end_seq_ids.begin(), view.end_seq_ids.end());
+    }
+    return view;
+}
+
+ACTION boundedagg::migratekeys(name org, uint32_t limit) {
+    require_auth(get_self());
+
+    // Re-emplaces up to `limit` rows so their secondary keys are rebuilt in the packed layout.
+    // Erasing first drops the legacy sha256 entries; rerun until the org is marked done.
+    keymigration_singleton keymigration_s(get_self(), org.value);
+    keymigration state = keymigration_s.get_or_default(keymigration { .next_badge_agg_seq_id = 0, .done = false });
+    check(!state.done, "badgestatus keys already migrated for org");
+
+    badgestatus_table badgestatus_t(get_self(), org.value);
+    auto itr = badgestatus_t.lower_bound(state.next_badge_agg_seq_id);
+    for (uint32_t migrated = 0; itr != badgestatus_t.end() && migrated < limit; migrated++) {
+        badgestatus row = *itr;
+        itr = badgestatus_t.erase(itr);
+        badgestatus_t.emplace(get_self(), [&](auto& r) {
+            r = row;
+        });
+        sync_fanout(org, row);
+        state.next_badge_agg_seq_id = row.badge_agg_seq_id + 1;
+    }
+    state.done = itr == badgestatus_t.end();
+    keymigration_s.set(state, get_self());
+}
 
-        // Ensure the "user" object exists.
-        if (j.find("user") == j.end() || !j["user"].is_object()) {
-            j["user"] = nlohmann::json::object();
+ACTION boundedagg::seedpause(name org, symbol agg_symbol, uint64_t seq_id, uint32_t limit) {
+    require_auth(get_self());
+
+    // Builds the pause bitmap of a sequence from its rows' badge_status, up to `limit` rows per
+    // call; rerun until seqbadges has the row. The packed aggseqbadge keys order the rows by
+    // badge, which is what lets a call pick up where the last one stopped.
+    check(!legacy_keys_pending(get_self(), org), "badgestatus keys not migrated for org, run migratekeys first");
+    seqbadges_table seqbadges_t(get_self(), agg_symbol.code().raw());
+    check(seqbadges_t.find(seq_id) == seqbadges_t.end(), "pause bitmap of sequence already seeded");
+    sequence_table sequence_t(get_self(), agg_symbol.code().raw());
+    check(sequence_t.find(seq_id) != sequence_t.end(), "Sequence ID does not exist.");
+
+    pauseseed_table pauseseed_t(get_self(), agg_symbol.code().raw());
+    auto seed_itr = pauseseed_t.find(seq_id);
+    pauseseed seed = seed_itr == pauseseed_t.end() ? pauseseed { .seq_id = seq_id, .next_badge = 0 } : *seed_itr;
+
+    badgestatus_table badgestatus_t(get_self(), org.value);
+    auto index = badgestatus_t.get_index<"aggseqbadge"_n>();
+    auto itr = index.lower_bound(badgestatus::agg_seq_badge_key(agg_symbol, seq_id, symbol(symbol_code(seed.next_badge), 0)));
+    for (uint32_t seeded = 0; itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id && seeded < limit; itr++, seeded++) {
+        set_pause_bit(seed.paused, badge_position(org, agg_symbol, itr->badge_symbol), itr->badge_status != "active"_n);
+        seed.next_badge = itr->badge_symbol.code().raw() + 1;
+    }
+
+    if (itr == index.end() || itr->agg_symbol != agg_symbol || itr->seq_id != seq_id) {
+        store_pause_bits(agg_symbol, seq_id, seed.paused);
+        if (seed_itr != pauseseed_t.end()) {
+            pauseseed_t.erase(seed_itr);
         }
+    } else if (seed_itr == pauseseed_t.end()) {
+        pauseseed_t.emplace(get_self(), [&](auto& row) {
+            row = seed;
+        });
+    } else {
+        pauseseed_t.modify(seed_itr, get_self(), [&](auto& row) {
+            row = seed;
+        });
+    }
+}
+
+ACTION boundedagg::syncstats(name org, symbol agg_symbol, vector<symbol> badge_symbols) {
+    string action_name = "syncstats";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+
+    // Sent by boundedstats after activate/deactivate so the fanout stats flags follow statssetting.
+    fanout_table fanout_t(get_self(), org.value);
+    for (const auto& badge_symbol : badge_symbols) {
+        auto itr = fanout_t.find(badge_symbol.code().raw());
+        if (itr == fanout_t.end()) {
+            continue;
+        }
+        bool stats = stats_enabled(agg_symbol, badge_symbol);
+        fanout_t.modify(itr, get_self(), [&](auto& f) {
+            for (auto& entry : f.entries) {
+                if (entry.agg_symbol == agg_symbol) {
+                    entry.stats = stats;
+                }
+            }
+        });
+    }
+}
 
-        // Restrictions:
-        // 1. "system" tag cannot be modified.
-        check(key != "system", "Cannot modify system tag in offchain lookup");
-        // (Note: "name" and "description" tags are allowed offchain.)
+void boundedagg::continuejob(uint64_t job_id, uint32_t max_steps) {
+    string action_name = "continue";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check(max_steps > 0, failure_identifier + "max_steps must be positive");
 
-        // Update or insert the key/value pair under the "user" tag.
-        j["user"][key] = value;
+    jobs_table jobs_t(get_self(), get_self().value);
+    auto itr = jobs_t.find(job_id);
+    check(itr != jobs_t.end(), failure_identifier + "job does not exist or has finished");
 
-        // Save the updated JSON back to the badge record.
-        aggdetail_t.modify(itr, get_self(), [&](auto& row) {
-            row.offchain_lookup_data = j.dump();
+    // Driven by the job's org or by the contract itself. The org is billed only for the rows
+    // a step actually inserted.
+    job queued = *itr;
+    if (!has_auth(get_self())) {
+        require_auth(queued.org);
+    }
+    uint64_t last_step = std::min(queued.total_steps, queued.next_step + max_steps);
+    uint64_t inserted = add_badge_steps(queued.org, queued.agg_symbol, queued.seq_ids, queued.badge_symbols, queued.next_step, last_step);
+
+    if (last_step == queued.total_steps) {
+        jobs_t.erase(itr);
+    } else {
+        jobs_t.modify(itr, get_self(), [&](auto& row) {
+            row.next_step = last_step;
         });
     }
+    bill(get_self(), queued.org, inserted);
+}
 
-    ACTION boundedagg::onckeyvalue(name org, symbol agg_symbol, string key, string value) {
-        string action_name = "onckeyvalue";
-        string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+boundedagg::job_view boundedagg::getjob(uint64_t job_id) {
+    jobs_table jobs_t(get_self(), get_self().value);
+    auto itr = jobs_t.find(job_id);
+    check(itr != jobs_t.end(), "job does not exist or has finished");
+    return make_job_view(*itr);
+}
+
+vector<boundedagg::job_view> boundedagg::getjobs(name org) {
+    jobs_table jobs_t(get_self(), get_self().value);
+    auto index = jobs_t.get_index<"byorg"_n>();
+    vector<job_view> jobs;
+    for (auto itr = index.lower_bound(org.value); itr != index.end() && itr->org == org; itr++) {
+        jobs.push_back(make_job_view(*itr));
+    }
+    return jobs;
+}
+
+ACTION boundedagg::archstart(name org, symbol agg_symbol, uint64_t seq_id) {
+    string action_name = "archstart";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    if(!has_auth(get_self())) {
         check_internal_auth(get_self(), name(action_name), failure_identifier);
+    }
+    archive_table archive_t(get_self(), agg_symbol.code().raw());
+    check(archive_t.find(seq_id) == archive_t.end(), failure_identifier + "Sequence archive already started.");
+
+    vector<uint64_t> badge_agg_seq_ids;
+    std::optional<schedule> sched = find_schedule(get_self(), agg_symbol, seq_id);
+    if (sched) {
+        // A scheduled window has no badgestatus rows; its ids follow from the schedule.
+        uint32_t window = seq_id - sched->first_seq_id;
+        check(window_status(*sched, window, time_point_sec(current_time_point())) == "end"_n, failure_identifier + "Sequence has not ended.");
+        for (uint64_t i = 0; i < sched->badge_symbols.size(); i++) {
+            badge_agg_seq_ids.push_back(window_seq_badge(*sched, window, i).badge_agg_seq_id);
+        }
+    } else {
+        check(current_seq_status(get_self(), agg_symbol, seq_id) == "end"_n, failure_identifier + "Sequence has not ended.");
+        badgestatus_table badgestatus_t(get_self(), org.value);
+        auto index = badgestatus_t.get_index<"byaggseq"_n>();
+        for (auto itr = index.find(badgestatus::combine_keys(agg_symbol.code().raw(), seq_id)); 
+            itr != index.end() && itr->agg_symbol == agg_symbol && itr->seq_id == seq_id; itr++) {
+            badge_agg_seq_ids.push_back(itr->badge_agg_seq_id);
+        }
+        std::sort(badge_agg_seq_ids.begin(), badge_agg_seq_ids.end());
+    }
 
-        // Open the aggdetail table.
-        aggdetail_table aggdetail_t(_self, org.value);
-        auto itr = aggdetail_t.find(agg_symbol.code().raw());
-        check(itr != aggdetail_t.end(), "Agg does not exist");
-
-        // Parse the current onchain_lookup_data.
-        nlohmann::json j;
-        if (itr->onchain_lookup_data.empty()) {
-            j = nlohmann::json::object();
-        } else if (nlohmann::json::accept(itr->onchain_lookup_data)) {
-            j = nlohmann::json::parse(itr->onchain_lookup_data);
-        } else {
-            check(false, "Stored onchain_lookup_data is not valid JSON");
+    archive_t.emplace(get_self(), [&](auto& row) {
+        row.seq_id = seq_id;
+        row.org = org;
+        row.badge_agg_seq_ids = badge_agg_seq_ids;
+        row.last_account = name();
+        row.leaf_count = 0;
+        row.branches = vector<checksum256>(ARCHIVE_TREE_DEPTH);
+        row.sealed = false;
+    });
+}
+
+ACTION boundedagg::archrows(name org, symbol agg_symbol, uint64_t seq_id, vector<name> accounts) {
+    string action_name = "archrows";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    if(!has_auth(get_self())) {
+        check_internal_auth(get_self(), name(action_name), failure_identifier);
+    }
+
+    archive_table archive_t(get_self(), agg_symbol.code().raw());
+    auto itr = archive_t.find(seq_id);
+    check(itr != archive_t.end() && itr->org == org, failure_identifier + "Sequence archive not started.");
+    check(!itr->sealed, failure_identifier + "Sequence archive already sealed.");
+
+    // Accounts come from an off-chain scan of the achpacks and achievements scopes. Requiring them in
+    // ascending order makes the leaf order reproducible for proofs and rules out archiving an account twice.
+    archive a = *itr;
+    for (const auto& account : accounts) {
+        check(a.last_account < account, failure_identifier + "accounts must be ascending and not yet archived");
+        a.last_account = account;
+
+        vector<achcount> packed;
+        achpack_table achpacks(get_self(), account.value);
+        auto pack_index = achpacks.get_index<"byaggseq"_n>();
+        auto pack_itr = pack_index.find(badgestatus::combine_keys(agg_symbol.code().raw(), seq_id));
+        if (pack_itr != pack_index.end()) {
+            packed = pack_itr->counts;
+            pack_index.erase(pack_itr);
+        }
+
+        // A count may still sit in a legacy achievements row, or be split across both.
+        achievements_table achievements(get_self(), account.value);
+        auto packed_itr = packed.begin();
+        for (const auto& badge_agg_seq_id : a.badge_agg_seq_ids) {
+            bool found = false;
+            uint64_t count = 0;
+            while (packed_itr != packed.end() && packed_itr->badge_agg_seq_id < badge_agg_seq_id) {
+                packed_itr++;
+            }
+            if (packed_itr != packed.end() && packed_itr->badge_agg_seq_id == badge_agg_seq_id) {
+                found = true;
+                count += packed_itr->count;
+            }
+            auto ach_itr = achievements.find(badge_agg_seq_id);
+            if (ach_itr != achievements.end()) {
+                found = true;
+                count += ach_itr->count;
+                achievements.erase(ach_itr);
+            }
+            if (found) {
+                append_archive_leaf(a, archive_leaf(account, badge_agg_seq_id, count));
+            }
         }
-        check(j.is_object(), "onchain_lookup_data must be a JSON object");
+    }
+
+    archive_t.modify(itr, get_self(), [&](auto& row) {
+        row.last_account = a.last_account;
+        row.leaf_count = a.leaf_count;
+        row.branches = a.branches;
+    });
+}
+
+ACTION boundedagg::archseal(name org, symbol agg_symbol, uint64_t seq_id) {
+    string action_name = "archseal";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    if(!has_auth(get_self())) {
+        check_internal_auth(get_self(), name(action_name), failure_identifier);
+    }
+
+    archive_table archive_t(get_self(), agg_symbol.code().raw());
+    auto itr = archive_t.find(seq_id);
+    check(itr != archive_t.end() && itr->org == org, failure_identifier + "Sequence archive not started.");
+    check(!itr->sealed, failure_identifier + "Sequence archive already sealed.");
+
+    checksum256 root = archive_root(*itr);
+    archive_t.modify(itr, get_self(), [&](auto& row) {
+        row.root = root;
+        row.sealed = true;
+        row.sealed_time = time_point_sec(current_time_point());
+        row.branches.clear();
+    });
+}
+
+bool boundedagg::verifyarch(symbol agg_symbol, uint64_t seq_id, name account, uint64_t badge_agg_seq_id, uint64_t count, uint64_t leaf_index, vector<checksum256> proof) {
+    archive_table archive_t(get_self(), agg_symbol.code().raw());
+    auto itr = archive_t.find(seq_id);
+    check(itr != archive_t.end() && itr->sealed, "Sequence archive not sealed.");
+    check(proof.size() == ARCHIVE_TREE_DEPTH, "proof must hold one sibling per tree level");
+    if (leaf_index >= itr->leaf_count) {
+        return false;
+    }
+
+    checksum256 node = archive_leaf(account, badge_agg_seq_id, count);
+    for (uint32_t h = 0; h < ARCHIVE_TREE_DEPTH; h++) {
+        node = ((leaf_index >> h) & 1) ? archive_node(proof[h], node) : archive_node(node, proof[h]);
+    }
+    return node == itr->root;
+}
+
+ACTION boundedagg::schedseq(name org, symbol agg_symbol, vector<symbol> badge_symbols, time_point_sec start, uint32_t length_sec, uint32_t count) {
+    string action_name = "schedseq";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(length_sec > 0, failure_identifier + "length_sec must be positive");
+    check(count > 0, failure_identifier + "count must be positive");
+    check(!badge_symbols.empty(), failure_identifier + "no badges given");
+    for (auto i = 0; i < badge_symbols.size(); i++) {
+        check(std::find(badge_symbols.begin() + i + 1, badge_symbols.end(), badge_symbols[i]) == badge_symbols.end(),
+            failure_identifier + "duplicate badge " + badge_symbols[i].code().to_string());
+    }
+
+    // A schedule whose windows have all closed is kept as their record; the new one follows it.
+    time_point_sec now = time_point_sec(current_time_point());
+    std::optional<schedule> last = last_schedule(get_self(), agg_symbol);
+    check(!last || schedule_closed(*last, now), failure_identifier + "Agg already has a schedule.");
+    if (last) {
+        unlink_schedule(org, agg_symbol, last->badge_symbols);
+    }
 
-        // Ensure the "user" object exists.
-        if (j.find("user") == j.end() || !j["user"].is_object()) {
-            j["user"] = nlohmann::json::object();
+    // Seq ids and badge_agg_seq_ids for every window are reserved up front, so windows never
+    // collide with sequences made by initseq and rolling over needs no writes.
+    aggdetail_table aggdetail_t(get_self(), org.value);
+    auto aggdetail_itr = aggdetail_t.find(agg_symbol.code().raw());
+    check(aggdetail_itr != aggdetail_t.end(), failure_identifier + "Aggregation symbol does not exist.");
+    uint64_t first_seq_id = aggdetail_itr->last_init_seq_id + 1;
+    aggdetail_t.modify(aggdetail_itr, get_self(), [&](auto& row) {
+        row.last_init_seq_id += count;
+    });
+    uint64_t first_badge_agg_seq_id = reserve_badge_agg_seq_ids(uint64_t(count) * badge_symbols.size());
+
+    schedule_table schedule_t(get_self(), agg_symbol.code().raw());
+    schedule_t.emplace(get_self(), [&](auto& row) {
+        row.agg_symbol = agg_symbol;
+        row.badge_symbols = badge_symbols;
+        row.start = start;
+        row.length_sec = length_sec;
+        row.count = count;
+        row.first_seq_id = first_seq_id;
+        row.first_badge_agg_seq_id = first_badge_agg_seq_id;
+    });
+
+    schedbadge_table schedbadge_t(get_self(), org.value);
+    for (const auto& badge_symbol : badge_symbols) {
+        auto itr = schedbadge_t.find(badge_symbol.code().raw());
+        if (itr == schedbadge_t.end()) {
+            schedbadge_t.emplace(get_self(), [&](auto& row) {
+                row.badge_symbol = badge_symbol;
+                row.agg_symbols.push_back(agg_symbol);
+            });
+        } else {
+            schedbadge_t.modify(itr, get_self(), [&](auto& row) {
+                row.agg_symbols.push_back(agg_symbol);
+            });
         }
+    }
 
-        // Restrictions:
-        // 1. "system" tag cannot be modified.
-        check(key != "system", "Cannot modify system tag in onchain lookup");
+    bill(get_self(), org, 1);
+}
 
+ACTION boundedagg::endsched(name org, symbol agg_symbol) {
+    string action_name = "endsched";
+    string failure_identifier = "CONTRACT: boundedagg, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
 
-        // Update or insert the key/value pair under the "user" tag.
-        j["user"][key] = value;
+    // Drops the windows that have not opened yet; an open window runs to its end and the
+    // schedule is unlinked from its badges once it closes.
+    schedule_table schedule_t(get_self(), agg_symbol.code().raw());
+    auto itr = schedule_t.end();
+    check(itr != schedule_t.begin(), failure_identifier + "Agg has no schedule.");
+    --itr;
+    time_point_sec now = time_point_sec(current_time_point());
+    check(!schedule_closed(*itr, now), failure_identifier + "Agg schedule has already closed.");
+    uint32_t started = 0;
+    if (!(now < itr->start)) {
+        uint64_t elapsed = (now.sec_since_epoch() - itr->start.sec_since_epoch()) / itr->length_sec + 1;
+        started = std::min<uint64_t>(elapsed, itr->count);
+    }
+    vector<symbol> badge_symbols = itr->badge_symbols;
+    if (started == 0) {
+        // No window ever opened, so there is nothing to keep a record of.
+        schedule_t.erase(itr);
+        unlink_schedule(org, agg_symbol, badge_symbols);
+        return;
+    }
+    schedule_t.modify(itr, get_self(), [&](auto& row) {
+        row.count = started;
+    });
+    if (!open_window(*itr, now)) {
+        unlink_schedule(org, agg_symbol, badge_symbols);
+    }
+}
 
-        // Save the updated JSON back to the badge record.
-        aggdetail_t.modify(itr, get_self(), [&](auto& row) {
-            row.onchain_lookup_data = j.dump();
-        });
-    } 
+boundedagg::window_view boundedagg::getwindow(name org, symbol agg_symbol) {
+    std::optional<schedule> itr = last_schedule(get_self(), agg_symbol);
+    check(itr.has_value(), "Agg has no schedule.");
+
+    time_point_sec now = time_point_sec(current_time_point());
+    std::optional<uint32_t> open = open_window(*itr, now);
+    uint32_t window = 0;
+    if (open) {
+        window = *open;
+    } else if (!(now < itr->start)) {
+        window = itr->count; // all windows have closed
+    }
+    uint64_t window_start = itr->start.sec_since_epoch() + uint64_t(window) * itr->length_sec;
+    return window_view {
+        .agg_symbol = agg_symbol,
+        .count = itr->count,
+        .open = open.has_value(),
+        .window = window,
+        .seq_id = itr->first_seq_id + window,
+        .window_start = time_point_sec(window_start),
+        .window_end = time_point_sec(window_start + itr->length_sec)
+    };
+}
@@ -1,36 +1,27 @@
 #include <boundedstats.hpp>
 
 
-void boundedstats::notifyachiev(name org, asset badge_asset, name from, name to, string memo, vector<name> notify_accounts) {
+void boundedstats::notifyissue(uint8_t version, name org, asset badge_asset, name from, name to, uint64_t issuance_seq, std::optional<uint64_t> balance) {
     string action_name = "settings";
     string failure_identifier = "CONTRACT: boundedstats, ACTION: " + action_name + ", MESSAGE: ";
-    badgestatus_table badgestatus(name(BOUNDED_AGG_CONTRACT), org.value); // Adjust scope as necessary
-    auto badge_status_index = badgestatus.get_index<"bybadgestat"_n>(); // Correct index name
-    auto hashed_active_status = hash_active_status(badge_asset.symbol, "active"_n, "active"_n);
-    auto itr = badge_status_index.find(hashed_active_status);
-    uint8_t actions_used = 0;
-    while(itr != badge_status_index.end() && itr->badge_symbol == badge_asset.symbol && itr->badge_status == "active"_n && itr->seq_status == "active"_n) {
-        statssetting_table _statssetting(get_self(), itr->agg_symbol.code().raw());
-        auto statssetting_itr = _statssetting.find(itr->badge_symbol.code().raw());
-        if(statssetting_itr != _statssetting.end()) {
-            uint64_t new_balance = get_new_balance(to, itr->badge_agg_seq_id);
-            uint64_t old_balance = new_balance - badge_asset.amount;
-            update_rank(org, to, itr->badge_agg_seq_id, old_balance, new_balance);
-            update_count(org, to, itr->badge_agg_seq_id, old_balance, new_balance);
-            actions_used ++;
-        }
-
-        itr++;
+    vector<seqbadge> seq_badges = stats_seq_badges(org, badge_asset.symbol);
+    for (const auto& seq_badge : seq_badges) {
+        record_issuance(org, to, seq_badge, badge_asset.amount);
     }
+    uint8_t actions_used = seq_badges.size();
 
-    action {
-        permission_level{get_self(), name("active")},
-        name(SUBSCRIPTION_CONTRACT),
-        name("billing"),
-        billing_args {
-            .org = org,
-            .actions_used = actions_used}
-    }.send();
+    bill(get_self(), org, actions_used);
+}
+
+void boundedstats::notifybatch(name org, symbol badge_symbol, name from, vector<pair<name, int64_t>> recipients, string memo) {
+    // Resolve the stats-enabled sequences once for the whole batch.
+    vector<seqbadge> seq_badges = stats_seq_badges(org, badge_symbol);
+    for (const auto& recipient : recipients) {
+        for (const auto& seq_badge : seq_badges) {
+            record_issuance(org, recipient.first, seq_badge, recipient.second);
+        }
+    }
+    bill(get_self(), org, seq_badges.size() * recipients.size());
 }
 
 ACTION boundedstats::activate(name org, symbol agg_symbol, vector<symbol> badge_symbols) {
@@ -47,6 +38,7 @@ ACTION boundedstats::activate(name org, symbol agg_symbol, vector<symbol> badge_
             entry.badge_symbol = badge_symbols[i];
         }); 
     }
+    sync_stats(org, agg_symbol, badge_symbols);
 }
 
 ACTION boundedstats::deactivate(name org, symbol agg_symbol, vector<symbol> badge_symbols) {
@@ -61,4 +53,89 @@ ACTION boundedstats::deactivate(name org, symbol agg_symbol, vector<symbol> badg
 
         _statssetting.erase(itr);
     }
+    sync_stats(org, agg_symbol, badge_symbols);
+}
+
+ACTION boundedstats::settopk(name org, symbol agg_symbol, uint16_t k) {
+    string action_name = "settopk";
+    string failure_identifier = "CONTRACT: boundedstats, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(k > 0, failure_identifier + "k must be positive");
+
+    // Top-K mode cannot be turned off again since ranks stop being written once it is on. For
+    // the same reason k cannot grow again: a board drops the leaders past a lowered k for good.
+    topk_table _topk(get_self(), org.value);
+    auto itr = _topk.find(agg_symbol.code().raw());
+    check(itr == _topk.end() || k <= itr->k, failure_identifier + "k can only be lowered once top-K mode is on");
+    if (itr == _topk.end()) {
+        _topk.emplace(get_self(), [&](auto& entry) {
+            entry.agg_symbol = agg_symbol;
+            entry.k = k;
+        });
+    } else {
+        _topk.modify(itr, get_self(), [&](auto& entry) {
+            entry.k = k;
+        });
+    }
+}
+
+ACTION boundedstats::backfillhist(name org, symbol agg_symbol, uint64_t badge_agg_seq_id, uint32_t limit) {
+    require_auth(get_self());
+
+    // Adds the ranks accounts the histogram has not counted yet, lowest balance first, up to
+    // `limit` of them. Once ranks is walked the histogram is backfilled, and later calls clear
+    // histcounted.
+    check(topk_size(org, agg_symbol) == 0, "agg is in top-K mode and ranks no longer lists its holders");
+
+    histogram_table _histogram(get_self(), org.value);
+    auto hist_itr = _histogram.find(badge_agg_seq_id);
+    if (hist_itr == _histogram.end()) {
+        hist_itr = _histogram.emplace(get_self(), [&](auto& entry) {
+            entry.badge_agg_seq_id = badge_agg_seq_id;
+            entry.next_balance = 0;
+            entry.backfilled = false;
+        });
+    }
+
+    histcounted_table _histcounted(get_self(), badge_agg_seq_id);
+    if (hist_itr->backfilled) {
+        auto itr = _histcounted.begin();
+        check(itr != _histcounted.end(), "histogram already backfilled for badge_agg_seq_id");
+        for (uint32_t erased = 0; itr != _histcounted.end() && erased < limit; erased++) {
+            itr = _histcounted.erase(itr);
+        }
+        return;
+    }
+
+    // A balance row is walked again from the start if the limit cuts into it; accounts already
+    // counted are skipped.
+    vector<uint64_t> buckets = hist_itr->buckets;
+    ranks_table _ranks(get_self(), badge_agg_seq_id);
+    auto itr = _ranks.lower_bound(hist_itr->next_balance);
+    uint64_t next_balance = hist_itr->next_balance;
+    uint32_t walked = 0;
+    for (; itr != _ranks.end() && walked < limit; itr++) {
+        uint32_t i = 0;
+        for (; i < itr->accounts.size() && walked < limit; i++, walked++) {
+            if (!mark_counted(badge_agg_seq_id, itr->accounts[i])) {
+                move_in_histogram(buckets, 0, itr->balance);
+            }
+        }
+        if (i < itr->accounts.size()) {
+            break;
+        }
+        next_balance = itr->balance + 1;
+    }
+    bool backfilled = itr == _ranks.end();
+    _histogram.modify(hist_itr, get_self(), [&](auto& entry) {
+        entry.buckets = buckets;
+        entry.next_balance = next_balance;
+        entry.backfilled = backfilled;
+    });
+}
+
+vector<percentile_view> boundedstats::percentiles(name org, uint64_t badge_agg_seq_id, vector<uint8_t> percentiles) {
+    histogram_table _histogram(get_self(), org.value);
+    auto itr = _histogram.find(badge_agg_seq_id);
+    return histogram_percentiles(itr == _histogram.end() ? vector<uint64_t>() : itr->buckets, percentiles);
 }
@@ -1,32 +1,16 @@
 #include <cumulative.hpp>
 
-void cumulative::notifyachiev(name org, asset badge_asset, name from, name to, std::string memo, std::vector<name> notify_accounts) {
-    // Access the accounts table scoped by "to"
-    accounts to_accounts(get_self(), to.value);
-
-    // Find the account using the amount's symbol code
-    auto existing_account = to_accounts.find(badge_asset.symbol.code().raw());
+void cumulative::notifyissue(uint8_t version, name org, asset badge_asset, name from, name to, uint64_t issuance_seq, std::optional<uint64_t> balance) {
+    credit(to, badge_asset);
+    
+    bill(get_self(), org, 1);
+}
 
-    if (existing_account == to_accounts.end()) {
-        // If the account does not exist, create a new one with the specified badge_asset
-        to_accounts.emplace(get_self(), [&](auto& acc) {
-            acc.balance = badge_asset;
-        });
-    } else {
-        // If the account exists, modify its balance
-        to_accounts.modify(existing_account, get_self(), [&](auto& acc) {
-            acc.balance += badge_asset; // Assuming you want to add the badge_asset to the existing balance
-        });
+void cumulative::notifybatch(name org, symbol badge_symbol, name from, vector<pair<name, int64_t>> recipients, string memo) {
+    for (const auto& recipient : recipients) {
+        credit(recipient.first, asset(recipient.second, badge_symbol));
     }
-    
-    action {
-        permission_level{get_self(), name("active")},
-        name(SUBSCRIPTION_CONTRACT),
-        name("billing"),
-        billing_args {
-            .org = org,
-            .actions_used = 1}
-    }.send();
+    bill(get_self(), org, recipients.size());
 }
 
 ACTION cumulative::dummy() {
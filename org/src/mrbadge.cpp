@@ -110,14 +110,7 @@ ACTION mrbadge::create (name org, symbol badge_symbol,
     }.send();
 
 
-    action {
-      permission_level{get_self(), name("active")},
-      name(SUBSCRIPTION_CONTRACT),
-      name("billing"),
-      billing_args {
-        .org = org,
-        .actions_used = 1}
-    }.send();
+    bill(get_self(), org, 1);
 
 }
 
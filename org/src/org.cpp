@@ -151,6 +151,20 @@ ACTION org::onckeyvalue(name org, string key, string value) {
   put_onchain_key_value(org, key, value);
 }
 
+ACTION org::offckvpatch(name org, vector<org_contract::kvop> ops) {
+  require_auth(org);
+  check(!ops.empty(), "No key/value operations given");
+
+  patch_offchain_lookup(org, ops);
+}
+
+ACTION org::onckvpatch(name org, vector<org_contract::kvop> ops) {
+  require_auth(org);
+  check(!ops.empty(), "No key/value operations given");
+
+  patch_onchain_lookup(org, ops);
+}
+
 ACTION org::addactionauth(name org, name action, name authorized_account) {
     require_auth(org);
 
@@ -40,27 +40,38 @@
 
     vector<name> consumers;
     consumers.push_back(name(SUBSCRIPTION_CONTRACT));
-    if(lifetime_aggregate) {
-      consumers.push_back(name(CUMULATIVE_CONTRACT));
-    }
     if(lifetime_aggregate && lifetime_stats) {
+      // statistics keeps the lifetime balances itself, so cumulative is not notified and
+      // holds no balances for the badge; they are read from statistics' lifetimebal table.
       consumers.push_back(name(STATISTICS_CONTRACT));
-    } else if (!lifetime_aggregate && lifetime_stats) {
-      check(false, "Enable Lifetime aggregates to capture Lifetime stats");
-    }
-
-    for (auto i = 0 ; i < consumers.size(); i++) {
       action {
         permission_level{get_self(), name("active")},
-        name(BADGEDATA_CONTRACT),
-        name("addfeature"),
-        addfeature_args {
+        name(STATISTICS_CONTRACT),
+        name("initlifetime"),
+        initlifetime_args {
           .org = org,
-          .badge_symbol = badge_symbol,
-          .notify_account = consumers[i],
-          .memo = memo}
+          .badge_symbol = badge_symbol }
       }.send();
+    } else if(lifetime_aggregate) {
+      consumers.push_back(name(CUMULATIVE_CONTRACT));
+    } else if (lifetime_stats) {
+      check(false, "Enable Lifetime aggregates to capture Lifetime stats");
+    }
+
+    vector<pair<symbol, name>> features;
+    for (auto i = 0 ; i < consumers.size(); i++) {
+      features.push_back({badge_symbol, consumers[i]});
     }
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("addfeatures"),
+      addfeatures_args {
+        .org = org,
+        .features = features,
+        .memo = memo
+      }
+    }.send();
      
   }
 
@@ -83,20 +94,28 @@
     }   
 
     notify_checks_contract(org);
-    asset badge_asset(amount, badge_symbol);
-    
+
+    // An empty list issues nothing, as it did when each recipient was issued separately.
+    if (to.empty()) {
+      return;
+    }
+
+    vector<pair<name, int64_t>> recipients;
     for( auto i = 0; i < to.size(); i++ ) {
-      action {
-      permission_level{get_self(), name("active")},
-      name(SIMPLEBADGE_CONTRACT),
-      name("issue"),
-      issuesimple_args {
-        .org = org,
-        .badge_asset = badge_asset,
-        .to = to[i],
-        .memo = memo }
-      }.send();
+      recipients.push_back({to[i], (int64_t)amount});
     }
+
+    // One issuance for the whole batch instead of one per recipient.
+    action {
+    permission_level{get_self(), name("active")},
+    name(SIMPLEBADGE_CONTRACT),
+    name("issuebatch"),
+    issuebatch_args {
+      .org = org,
+      .badge_symbol = badge_symbol,
+      .recipients = recipients,
+      .memo = memo }
+    }.send();
   }
 
 
@@ -134,6 +153,80 @@
 
   }
 
+  ACTION simmanager::settopk (name authorized, symbol badge_symbol, uint16_t k) {
+    require_auth(authorized);
+    string action_name = "settopk";
+    string failure_identifier = "CONTRACT: simmanager, ACTION: " + action_name + ", MESSAGE: ";
+    name org = get_org_from_internal_symbol(badge_symbol, failure_identifier);
+    name badge = get_name_from_internal_symbol(badge_symbol, failure_identifier);
+
+    if(org != authorized) {
+      bool has_authority = has_action_authority(org, name(action_name), authorized) ||
+        has_badge_authority(org, name(action_name), badge, authorized);
+      check (has_authority, failure_identifier + "Unauthorized account to execute action");
+    }  
+
+    notify_checks_contract(org);
+
+    action {
+    permission_level{get_self(), name("active")},
+    name(STATISTICS_CONTRACT),
+    name("settopk"),
+    settopk_args {
+      .org = org,
+      .badge_symbol = badge_symbol,
+      .k = k }
+    }.send();
+  }
+
+  ACTION simmanager::setwindow (name authorized, symbol badge_symbol, uint32_t bucket_sec, uint16_t bucket_count) {
+    require_auth(authorized);
+    string action_name = "setwindow";
+    string failure_identifier = "CONTRACT: simmanager, ACTION: " + action_name + ", MESSAGE: ";
+    name org = get_org_from_internal_symbol(badge_symbol, failure_identifier);
+    name badge = get_name_from_internal_symbol(badge_symbol, failure_identifier);
+
+    if(org != authorized) {
+      bool has_authority = has_action_authority(org, name(action_name), authorized) ||
+        has_badge_authority(org, name(action_name), badge, authorized);
+      check (has_authority, failure_identifier + "Unauthorized account to execute action");
+    }  
+
+    notify_checks_contract(org);
+
+    action {
+    permission_level{get_self(), name("active")},
+    name(STATISTICS_CONTRACT),
+    name("setwindow"),
+    setwindow_args {
+      .org = org,
+      .badge_symbol = badge_symbol,
+      .bucket_sec = bucket_sec,
+      .bucket_count = bucket_count }
+    }.send();
+  }
+
+  ACTION simmanager::seteventlog (name authorized, name org, uint32_t capacity) {
+    require_auth(authorized);
+    string action_name = "seteventlog";
+    string failure_identifier = "CONTRACT: simmanager, ACTION: " + action_name + ", MESSAGE: ";
+
+    if(org != authorized) {
+      check (has_action_authority(org, name(action_name), authorized), failure_identifier + "Unauthorized account to execute action");
+    }  
+
+    notify_checks_contract(org);
+
+    action {
+    permission_level{get_self(), name("active")},
+    name(BADGEDATA_CONTRACT),
+    name("seteventlog"),
+    seteventlog_args {
+      .org = org,
+      .capacity = capacity }
+    }.send();
+  }
+
 ACTION simmanager::addbadgeauth(name org, name action, name badge, name authorized_account) {
     require_auth(org);
 
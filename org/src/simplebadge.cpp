@@ -32,14 +32,7 @@
         .memo = memo }
     }.send();
     
-    action {
-      permission_level{get_self(), name("active")},
-      name(SUBSCRIPTION_CONTRACT),
-      name("billing"),
-      billing_args {
-        .org = org,
-        .actions_used = 1}
-    }.send();
+    bill(get_self(), org, 1);
   }
 
   ACTION simplebadge::issue (name org, asset badge_asset, name to, string memo) {
@@ -60,4 +53,20 @@
     }.send();
   }
 
-    
+  ACTION simplebadge::issuebatch (name org, symbol badge_symbol, vector<pair<name, int64_t>> recipients, string memo) {
+    string action_name = "issuebatch";
+    string failure_identifier = "CONTRACT: simplebadge, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+
+    action {
+      permission_level{get_self(), name("active")},
+      name(BADGEDATA_CONTRACT),
+      name("achievements"),
+      achievements_args {
+        .org = org,
+        .badge_symbol = badge_symbol,
+        .from = get_self(),
+        .recipients = recipients,
+        .memo = memo }
+    }.send();
+  }
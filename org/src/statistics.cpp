@@ -1,33 +1,231 @@
 #include <statistics.hpp>
 
 
-void statistics::notifyachiev(
+void statistics::notifyissue(
+    uint8_t version,
     name org,
     asset badge_asset, 
     name from, 
     name to, 
-    string memo, 
-    vector<name> notify_accounts) {
+    uint64_t issuance_seq, 
+    std::optional<uint64_t> balance) {
 
-    string action_name = "notifyachiev";
+    string action_name = "notifyissue";
     string failure_identifier = "CONTRACT: statistics, ACTION: " + action_name + ", MESSAGE: ";
-    accounts _accounts(name(CUMULATIVE_CONTRACT), to.value);
-    auto accounts_itr = _accounts.find(badge_asset.symbol.code().raw());
+    record_issuance(org, to, badge_asset, balance, owns_balances(org, badge_asset.symbol));
+    update_rolling(org, badge_asset.symbol, badge_asset.amount, 1);
     
-    uint64_t new_balance = (accounts_itr == _accounts.end()) ? 0 : accounts_itr->balance.amount;
-    update_rank(org, to, badge_asset.symbol, new_balance - badge_asset.amount, new_balance);
-    update_count(org, to, badge_asset.symbol, new_balance - badge_asset.amount, new_balance);
-    
-    action {
-        permission_level{get_self(), name("active")},
-        name(SUBSCRIPTION_CONTRACT),
-        name("billing"),
-        billing_args {
-            .org = org,
-            .actions_used = 1}
-    }.send();
+    bill(get_self(), org, 1);
+}
+
+void statistics::notifybatch(
+    name org,
+    symbol badge_symbol,
+    name from,
+    vector<pair<name, int64_t>> recipients,
+    string memo) {
+
+    bool owns_balance = owns_balances(org, badge_symbol);
+    uint64_t issued = 0;
+    for (const auto& recipient : recipients) {
+        record_issuance(org, recipient.first, asset(recipient.second, badge_symbol), std::nullopt, owns_balance);
+        issued += recipient.second;
+    }
+    update_rolling(org, badge_symbol, issued, recipients.size());
+    bill(get_self(), org, recipients.size());
 }
 
 ACTION statistics::dummy() {
 }
 
+ACTION statistics::migrateranks(symbol badge_symbol, uint32_t limit) {
+    require_auth(get_self());
+
+    // Moves up to `limit` accounts from the legacy balance rows into rankings, lowest balance
+    // first. Accounts already in rankings were updated since and keep their newer balance.
+    ranks_table _ranks(get_self(), badge_symbol.code().raw());
+    rankings_table _rankings(get_self(), badge_symbol.code().raw());
+    auto itr = _ranks.begin();
+    check(itr != _ranks.end(), "no legacy ranks left for badge");
+    uint32_t migrated = 0;
+    while (itr != _ranks.end() && migrated < limit) {
+        vector<name> accounts = itr->accounts;
+        while (!accounts.empty() && migrated < limit) {
+            name account = accounts.back();
+            accounts.pop_back();
+            if (_rankings.find(account.value) == _rankings.end()) {
+                _rankings.emplace(get_self(), [&](auto& entry) {
+                    entry.account = account;
+                    entry.balance = itr->balance;
+                });
+            }
+            migrated++;
+        }
+        if (accounts.empty()) {
+            itr = _ranks.erase(itr);
+        } else {
+            _ranks.modify(itr, get_self(), [&](auto& entry) {
+                entry.accounts = accounts;
+            });
+        }
+    }
+}
+
+ACTION statistics::backfillhist(name org, symbol badge_symbol, uint32_t limit) {
+    require_auth(get_self());
+
+    // Adds up to `limit` rankings accounts the histogram has not counted yet, in account order.
+    // Once rankings is walked the histogram is backfilled, and later calls clear histcounted.
+    ranks_table _ranks(get_self(), badge_symbol.code().raw());
+    check(_ranks.begin() == _ranks.end(), "legacy ranks left for badge, run migrateranks first");
+    leaderboard_table _leaderboard(get_self(), org.value);
+    check(_leaderboard.find(badge_symbol.code().raw()) == _leaderboard.end(), "badge is in top-K mode and rankings no longer lists its holders");
+
+    histogram_table _histogram(get_self(), org.value);
+    auto hist_itr = _histogram.find(badge_symbol.code().raw());
+    if (hist_itr == _histogram.end()) {
+        hist_itr = _histogram.emplace(get_self(), [&](auto& entry) {
+            entry.badge_symbol = badge_symbol;
+            entry.next_account = name();
+            entry.backfilled = false;
+        });
+    }
+
+    histcounted_table _histcounted(get_self(), badge_symbol.code().raw());
+    if (hist_itr->backfilled) {
+        auto itr = _histcounted.begin();
+        check(itr != _histcounted.end(), "histogram already backfilled for badge");
+        for (uint32_t erased = 0; itr != _histcounted.end() && erased < limit; erased++) {
+            itr = _histcounted.erase(itr);
+        }
+        return;
+    }
+
+    vector<uint64_t> buckets = hist_itr->buckets;
+    rankings_table _rankings(get_self(), badge_symbol.code().raw());
+    auto itr = _rankings.lower_bound(hist_itr->next_account.value);
+    name next_account = hist_itr->next_account;
+    for (uint32_t walked = 0; itr != _rankings.end() && walked < limit; itr++, walked++) {
+        if (!mark_counted(badge_symbol, itr->account)) {
+            move_in_histogram(buckets, 0, itr->balance);
+        }
+        next_account = name(itr->account.value + 1);
+    }
+    bool backfilled = itr == _rankings.end();
+    _histogram.modify(hist_itr, get_self(), [&](auto& entry) {
+        entry.buckets = buckets;
+        entry.next_account = next_account;
+        entry.backfilled = backfilled;
+    });
+}
+
+ACTION statistics::settopk(name org, symbol badge_symbol, uint16_t k) {
+    string action_name = "settopk";
+    string failure_identifier = "CONTRACT: statistics, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+    check(k > 0, failure_identifier + "k must be positive");
+    ranks_table _ranks(get_self(), badge_symbol.code().raw());
+    check(_ranks.begin() == _ranks.end(), failure_identifier + "legacy ranks left for badge, run migrateranks first");
+
+    // Top-K mode cannot be turned off again since rankings stop being written once it is on.
+    // The board starts from the current top of rankings; shrinking k drops the lowest leaders.
+    // For the same reason k cannot grow again: the dropped leaders are not kept anywhere.
+    leaderboard_table _leaderboard(get_self(), org.value);
+    auto itr = _leaderboard.find(badge_symbol.code().raw());
+    check(itr == _leaderboard.end() || k <= itr->k, failure_identifier + "k can only be lowered once top-K mode is on");
+    if (itr == _leaderboard.end()) {
+        rankings_table _rankings(get_self(), badge_symbol.code().raw());
+        auto by_balance = _rankings.get_index<"bybalance"_n>();
+        vector<leader> leaders;
+        for (auto rank_itr = by_balance.end(); rank_itr != by_balance.begin() && leaders.size() < k;) {
+            --rank_itr;
+            leaders.push_back(leader { .account = rank_itr->account, .balance = rank_itr->balance });
+        }
+        _leaderboard.emplace(get_self(), [&](auto& entry) {
+            entry.badge_symbol = badge_symbol;
+            entry.k = k;
+            entry.leaders = leaders;
+        });
+    } else {
+        _leaderboard.modify(itr, get_self(), [&](auto& entry) {
+            entry.k = k;
+            if (entry.leaders.size() > k) {
+                entry.leaders.resize(k);
+            }
+        });
+    }
+}
+
+vector<percentile_view> statistics::percentiles(name org, symbol badge_symbol, vector<uint8_t> percentiles) {
+    histogram_table _histogram(get_self(), org.value);
+    auto itr = _histogram.find(badge_symbol.code().raw());
+    return histogram_percentiles(itr == _histogram.end() ? vector<uint64_t>() : itr->buckets, percentiles);
+}
+
+ACTION statistics::setwindow(name org, symbol badge_symbol, uint32_t bucket_sec, uint16_t bucket_count) {
+    string action_name = "setwindow";
+    string failure_identifier = "CONTRACT: statistics, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+
+    rolling_table _rolling(get_self(), org.value);
+    auto itr = _rolling.find(badge_symbol.code().raw());
+    if (bucket_count == 0) {
+        check(itr != _rolling.end(), failure_identifier + "no rolling window kept for badge");
+        _rolling.erase(itr);
+        return;
+    }
+    check(bucket_sec > 0, failure_identifier + "bucket_sec must be positive");
+
+    rolling window {
+        .badge_symbol = badge_symbol,
+        .bucket_sec = bucket_sec,
+        .head_bucket = current_bucket(bucket_sec),
+        .issued = vector<uint64_t>(bucket_count),
+        .issuances = vector<uint64_t>(bucket_count)
+    };
+    if (itr == _rolling.end()) {
+        _rolling.emplace(get_self(), [&](auto& entry) {
+            entry = window;
+        });
+    } else {
+        _rolling.modify(itr, get_self(), [&](auto& entry) {
+            entry = window;
+        });
+    }
+}
+
+statistics::window_view statistics::windowstats(name org, symbol badge_symbol, uint32_t window_sec) {
+    window_view view { .issued = 0, .issuances = 0, .window_sec = 0 };
+    rolling_table _rolling(get_self(), org.value);
+    auto itr = _rolling.find(badge_symbol.code().raw());
+    if (itr == _rolling.end()) {
+        return view;
+    }
+    rolling window = *itr;
+    advance_window(window, current_bucket(window.bucket_sec));
+    uint64_t size = window.issued.size();
+    uint64_t buckets = std::min<uint64_t>((uint64_t(window_sec) + window.bucket_sec - 1) / window.bucket_sec, size);
+    for (uint64_t i = 0; i < buckets; i++) {
+        uint64_t slot = (window.head_bucket % size + size - i) % size;
+        view.issued += window.issued[slot];
+        view.issuances += window.issuances[slot];
+    }
+    view.window_sec = buckets * window.bucket_sec;
+    return view;
+}
+
+ACTION statistics::initlifetime(name org, symbol badge_symbol) {
+    string action_name = "initlifetime";
+    string failure_identifier = "CONTRACT: statistics, ACTION: " + action_name + ", MESSAGE: ";
+    check_internal_auth(get_self(), name(action_name), failure_identifier);
+
+    // Only for badges nothing was issued of yet, as earlier balances would sit in cumulative.
+    counts_table _counts(get_self(), org.value);
+    check(_counts.find(badge_symbol.code().raw()) == _counts.end(), failure_identifier + "badge already has issuances");
+
+    lifetime_table _lifetime(get_self(), org.value);
+    check(_lifetime.find(badge_symbol.code().raw()) == _lifetime.end(), failure_identifier + "lifetime balances already kept for badge");
+    _lifetime.emplace(get_self(), [&](auto& entry) {
+        entry.badge_symbol = badge_symbol;
+    });
+}